@@ -0,0 +1,332 @@
+#include <getopt.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../Headers/RandomWalkModel.h"
+#include "../Headers/RandomWalkModelParallel.h"
+#include "../Headers/TransitionProbabilities.h"
+#include "../Headers/NeighbourStencil.h"
+#include "../Headers/RandomNumberGenerator.h"
+#include "../Headers/ImageGenerator.h"
+#include "../Headers/ThreadPool.h"
+#include "../Headers/ProgramInfoViewer.h"
+
+using namespace std;
+
+/**
+ * Kernel benchmarks of the simulator, reported as individuals (cells) processed per second.
+ * Each benchmark is repeated until it ran for the minimum time, and the results are printed
+ * as a table and written as JSON to track regressions across versions.
+ *
+ * Build: g++ -std=c++17 -O2 -pthread Benchmarks/KernelBenchmark.cc -o KernelBenchmark
+ * Usage: KernelBenchmark [-s | --sizes 256,1024,4096] [-t | --threads 1,2,4] [-m | --min-time 0.5]
+ *                        [-j | --json KernelBenchmark.json] [-o | --output-directory .]
+ */
+
+using Model = StaticRandomWalkModel<TransitionTable::STATE_COUNT, TRANSITION_PROBABILITIES>;
+
+using ParallelModel = StaticRandomWalkModelParallel<TransitionTable::STATE_COUNT, TRANSITION_PROBABILITIES>;
+
+/**
+ * Gives the benchmarks access to the steps of a serial or parallel model.
+ */
+template <typename BaseModel>
+class BenchmarkModelOf : public BaseModel {
+
+    private:
+
+        vector<uint8_t> snapshot;
+
+    public:
+
+        using BaseModel::BaseModel;
+        using BaseModel::beginGeneration;
+        using BaseModel::individualTransition;
+        using BaseModel::nextGeneration;
+        using BaseModel::initializeStateCounts;
+        using BaseModel::nextSparseGeneration;
+
+        /**
+         * Replace the single sick individual by a mix of every state, so every transition path is exercised.
+         */
+        void randomizePopulation(uint64_t seed)
+        {
+            uint64_t key = RandomNumberGenerator(seed).getGenerationKey(0, 0);
+            for (int i = 0; i < this->populationMatrixSize; ++i) {
+                for (int j = 0; j < this->populationMatrixSize; ++j) {
+                    uint32_t bits = RandomNumberGenerator::getRandomBits(key, i, j);
+                    this->population.set(i, j, static_cast<State>(bits % 100 < 60 ? 0 : bits % TransitionTable::STATE_COUNT));
+                }
+            }
+            this->initializeStateCounts();
+        }
+
+        /**
+         * Keep the current population, so every timed generation can start from it again.
+         */
+        void saveSnapshot()
+        {
+            this->snapshot.assign(this->population.data(), this->population.data() + this->population.getMemorySize());
+        }
+
+        /**
+         * Back to the saved population at generation 0, with the sparse frontier rebuilt from it.
+         */
+        void restoreSnapshot()
+        {
+            copy(this->snapshot.begin(), this->snapshot.end(), this->population.data());
+            this->generation = 0;
+            this->contagionFactor = this->initialContagionFactor;
+            this->initializeStateCounts();
+            if (this->engine == UpdateEngine::sparse) {
+                this->initializeActiveCells();
+            }
+        }
+
+        const PopulationGrid& getPopulation() const
+        {
+            return this->population;
+        }
+
+};
+
+using BenchmarkModel = BenchmarkModelOf<Model>;
+
+using BenchmarkParallelModel = BenchmarkModelOf<ParallelModel>;
+
+struct BenchmarkResult {
+    string name;
+    int size;
+    int threads;
+    uint64_t iterations;
+    double seconds;
+    double cellsPerSecond;
+};
+
+/**
+ * Run the body until the minimum time is reached, each call processing the given number of cells.
+ * The prepare step, when given, runs before each call and is not timed.
+ */
+BenchmarkResult measure(const string& name, int size, int threads, uint64_t cellsPerIteration, double minimumTime,
+                        const function<void()>& body, const function<void()>& prepare = nullptr)
+{
+    if (prepare) {
+        prepare();
+    }
+    body(); // Warm up.
+    uint64_t iterations = 0;
+    double seconds = 0.0;
+    do {
+        if (prepare) {
+            prepare();
+        }
+        auto start = chrono::steady_clock::now();
+        body();
+        seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        iterations++;
+    } while (seconds < minimumTime);
+    BenchmarkResult result = {name, size, threads, iterations, seconds, static_cast<double>(cellsPerIteration) * iterations / seconds};
+    cout << left << setw(28) << name << right << setw(8) << size << setw(9) << threads << setw(12) << iterations
+         << setw(16) << scientific << setprecision(3) << result.cellsPerSecond << defaultfloat << endl;
+    return result;
+}
+
+vector<int> parseList(const string& text)
+{
+    vector<int> values;
+    stringstream stream(text);
+    string value;
+    while (getline(stream, value, ',')) {
+        values.push_back(stoi(value));
+    }
+    return values;
+}
+
+void writeJson(const string& filename, const vector<BenchmarkResult>& results, double minimumTime)
+{
+    ofstream json(filename);
+    json << "{\n";
+    json << "  \"version\": \"" << VERSION << "\",\n";
+    json << "  \"compiler\": \"" << __VERSION__ << "\",\n";
+    json << "  \"hardware_threads\": " << thread::hardware_concurrency() << ",\n";
+    json << "  \"min_time\": " << minimumTime << ",\n";
+    json << "  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& result = results[i];
+        json << "    {\"name\": \"" << result.name << "\", \"size\": " << result.size << ", \"threads\": " << result.threads
+             << ", \"iterations\": " << result.iterations << ", \"seconds\": " << setprecision(9) << result.seconds
+             << ", \"cells_per_second\": " << setprecision(6) << result.cellsPerSecond << "}"
+             << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n";
+    json << "}\n";
+    if (!json) {
+        throw runtime_error("ERROR: Could not write " + filename + ".");
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    vector<int> sizes = {256, 1024, 4096};
+    vector<int> threadCounts;
+    for (int threads = 1; threads <= MultithreadingController::getCurrentProcessorAvailableThreads(); threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    double minimumTime = 0.5;
+    string jsonFilename = "KernelBenchmark.json";
+    string outputDirectory = ".";
+
+    const char* shortOptions = "s:t:m:j:o:h";
+    const option longOptions[] = {
+        {"sizes", required_argument, nullptr, 's'},
+        {"threads", required_argument, nullptr, 't'},
+        {"min-time", required_argument, nullptr, 'm'},
+        {"json", required_argument, nullptr, 'j'},
+        {"output-directory", required_argument, nullptr, 'o'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, no_argument, nullptr, 0}
+    };
+    int cliOption;
+    try {
+        while ((cliOption = getopt_long(argc, argv, shortOptions, longOptions, nullptr)) != -1) {
+            switch (cliOption) {
+                case 's': sizes = parseList(optarg); break;
+                case 't': threadCounts = parseList(optarg); break;
+                case 'm': minimumTime = stod(optarg); break;
+                case 'j': jsonFilename = optarg; break;
+                case 'o': outputDirectory = optarg; break;
+                case 'h':
+                    cout << "Usage: KernelBenchmark [-s | --sizes <list>] [-t | --threads <list>] [-m | --min-time <seconds>]" << endl;
+                    cout << "                       [-j | --json <file>] [-o | --output-directory <directory>]" << endl;
+                    return EXIT_SUCCESS;
+                default:
+                    cerr << "Unknown option. Use -h for usage information." << endl;
+                    return EXIT_FAILURE;
+            }
+        }
+    } catch (const exception&) {
+        cerr << "ERROR: Invalid benchmark option value." << endl;
+        return EXIT_FAILURE;
+    }
+
+    cout << left << setw(28) << "benchmark" << right << setw(8) << "size" << setw(9) << "threads" << setw(12) << "iterations"
+         << setw(16) << "cells/s" << endl;
+
+    vector<BenchmarkResult> results;
+    const double contagionFactor = 0.5;
+    try {
+        for (int size : sizes) {
+            const uint64_t cells = static_cast<uint64_t>(size) * size;
+
+            BenchmarkModel model(size, contagionFactor, true);
+            model.setRandomStream(1, 0);
+            model.randomizePopulation(1);
+            model.saveSnapshot();
+
+            // Packed neighbour counts of the population, as given to the transitions.
+            vector<uint8_t> neighbourCounts(cells);
+            for (int i = 0; i < size; ++i) {
+                for (int j = 0; j < size; ++j) {
+                    neighbourCounts[static_cast<size_t>(i) * size + j] = NeighbourStencil::countCell(model.getPopulation(), i, j);
+                }
+            }
+
+            uint64_t generationKey = RandomNumberGenerator(1).getGenerationKey(0, 0);
+            double randomSum = 0.0;
+            results.push_back(measure("getRandomNumber", size, 1, cells, minimumTime, [&]() {
+                for (int i = 0; i < size; ++i) {
+                    for (int j = 0; j < size; ++j) {
+                        randomSum += RandomNumberGenerator::getRandomNumber(generationKey, i, j);
+                    }
+                }
+            }));
+
+            vector<uint8_t> rowCounts(cells);
+            results.push_back(measure("NeighbourStencil::countRow", size, 1, cells, minimumTime, [&]() {
+                const PopulationGrid& population = model.getPopulation();
+                for (int i = 0; i < size; ++i) {
+                    NeighbourStencil::countRow(population.row(i - 1), population.row(i), population.row(i + 1), size,
+                                               rowCounts.data() + static_cast<size_t>(i) * size);
+                }
+            }));
+
+            model.beginGeneration();
+            results.push_back(measure("individualTransition", size, 1, cells, minimumTime, [&]() {
+                for (int i = 0; i < size; ++i) {
+                    for (int j = 0; j < size; ++j) {
+                        model.individualTransition(i, j, neighbourCounts[static_cast<size_t>(i) * size + j], 0);
+                    }
+                }
+            }));
+
+            // Each generation starts from the randomized population, so the work is the same for every version.
+            results.push_back(measure("nextGeneration", size, 1, cells, minimumTime, [&]() {
+                model.nextGeneration();
+            }, [&]() {
+                model.restoreSnapshot();
+            }));
+            model.restoreSnapshot();
+
+            // The sparse engine is credited with every cell of the grid, to compare with nextGeneration.
+            BenchmarkModel sparseModel(size, contagionFactor, true);
+            sparseModel.setRandomStream(1, 0);
+            sparseModel.setUpdateEngine(UpdateEngine::sparse);
+            sparseModel.randomizePopulation(1);
+            sparseModel.saveSnapshot();
+            results.push_back(measure("nextSparseGeneration", size, 1, cells, minimumTime, [&]() {
+                sparseModel.nextSparseGeneration();
+            }, [&]() {
+                sparseModel.restoreSnapshot();
+            }));
+
+            results.push_back(measure("initializeStateCounts", size, 1, cells, minimumTime, [&]() {
+                model.initializeStateCounts();
+            }));
+
+            string imageFilename = outputDirectory + "/KernelBenchmark.png";
+            streambuf* standardOutput = cout.rdbuf();
+            ostringstream discardedOutput;
+            results.push_back(measure("ImageGenerator::generate", size, 1, cells, minimumTime, [&]() {
+                cout.rdbuf(discardedOutput.rdbuf());
+                ImageGenerator::generate(imageFilename.c_str(), model.getPopulation());
+                cout.rdbuf(standardOutput);
+                discardedOutput.str("");
+            }));
+            remove(imageFilename.c_str());
+
+            for (int threads : threadCounts) {
+                ThreadPool threadPool(threads);
+                BenchmarkParallelModel parallelModel(size, contagionFactor, true, threadPool);
+                parallelModel.setRandomStream(1, 0);
+                parallelModel.randomizePopulation(1);
+                parallelModel.saveSnapshot();
+                results.push_back(measure("parallelSimulation", size, threads, cells, minimumTime, [&]() {
+                    parallelModel.parallelSimulation(1);
+                }, [&]() {
+                    parallelModel.restoreSnapshot();
+                }));
+            }
+
+            // Keep the accumulated values alive.
+            if (randomSum < 0.0 || rowCounts[0] > 0x99) {
+                cout << randomSum << rowCounts[0] << endl;
+            }
+        }
+
+        writeJson(jsonFilename, results, minimumTime);
+        cout << "\nResults saved as " << jsonFilename << endl;
+    } catch (const exception& exception) {
+        cerr << exception.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
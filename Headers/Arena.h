@@ -0,0 +1,260 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <sys/mman.h>
+
+using namespace std;
+
+/**
+ * The arena hands out memory by bumping an offset into large anonymous mappings, backed by
+ * huge pages when the system has some reserved, or else by transparent huge pages on aligned
+ * blocks. Nothing is freed individually: rewind releases every allocation made since a
+ * marker at once, and keeps the blocks mapped so the next allocations reuse pages that are
+ * already faulted in. The blocks are unmapped with the arena.
+ *
+ * An arena is not thread safe, each model owns one and allocates from a single thread.
+ */
+class Arena {
+
+    public:
+
+        static constexpr size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+        /**
+         * Position of the arena, to rewind to.
+         */
+        struct Marker {
+            size_t block = 0;
+            size_t offset = 0;
+        };
+
+    private:
+
+        struct Block {
+            uint8_t* data;
+            size_t size;
+            bool hugePages;
+        };
+
+        vector<Block> blocks;
+
+        /**
+         * Block being bumped, and the offset of its first free byte.
+         */
+        size_t currentBlock = 0;
+
+        size_t offset = 0;
+
+        /**
+         * Size of the next block mapped, doubled each time one is.
+         */
+        size_t blockSize;
+
+        static size_t roundUp(size_t value, size_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        /**
+         * Map a block of huge pages, or of normal pages aligned to a huge page and advised
+         * to be backed by transparent ones.
+         */
+        static Block mapBlock(size_t size)
+        {
+            size = roundUp(size, HUGE_PAGE_SIZE);
+#ifdef MAP_HUGETLB
+            void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (data != MAP_FAILED) {
+                return {static_cast<uint8_t*>(data), size, true};
+            }
+#endif
+            void* mapping = mmap(nullptr, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mapping == MAP_FAILED) {
+                throw bad_alloc();
+            }
+            uint8_t* start = static_cast<uint8_t*>(mapping);
+            uint8_t* aligned = reinterpret_cast<uint8_t*>(roundUp(reinterpret_cast<uintptr_t>(start), HUGE_PAGE_SIZE));
+            if (aligned > start) {
+                munmap(start, aligned - start);
+            }
+            size_t tail = (start + size + HUGE_PAGE_SIZE) - (aligned + size);
+            if (tail > 0) {
+                munmap(aligned + size, tail);
+            }
+#ifdef MADV_HUGEPAGE
+            madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+            return {aligned, size, false};
+        }
+
+    public:
+
+        /**
+         * Constructor, the first block is mapped on the first allocation.
+         */
+        explicit Arena(size_t blockSize = HUGE_PAGE_SIZE)
+            : blockSize(roundUp(blockSize > 0 ? blockSize : 1, HUGE_PAGE_SIZE))
+        {
+        }
+
+        ~Arena()
+        {
+            for (const Block& block : this->blocks) {
+                munmap(block.data, block.size);
+            }
+        }
+
+        Arena(const Arena&) = delete;
+
+        Arena& operator=(const Arena&) = delete;
+
+        /**
+         * Memory for the given bytes, aligned to the given power of two.
+         * Moves to the next block that fits once the current one is full, mapping a new one if none does.
+         */
+        void* allocate(size_t bytes, size_t alignment = 64)
+        {
+            while (this->currentBlock < this->blocks.size()) {
+                const Block& block = this->blocks[this->currentBlock];
+                size_t start = roundUp(this->offset, alignment);
+                if (start + bytes <= block.size) {
+                    this->offset = start + bytes;
+                    return block.data + start;
+                }
+                this->currentBlock++;
+                this->offset = 0;
+            }
+            Block block = mapBlock(max(this->blockSize, bytes + alignment));
+            this->blockSize *= 2;
+            this->blocks.push_back(block);
+            this->currentBlock = this->blocks.size() - 1;
+            this->offset = bytes;
+            return block.data;
+        }
+
+        Marker mark() const
+        {
+            return {this->currentBlock, this->offset};
+        }
+
+        /**
+         * Release every allocation made since the marker was taken.
+         */
+        void rewind(const Marker& marker)
+        {
+            this->currentBlock = marker.block;
+            this->offset = marker.offset;
+        }
+
+        /**
+         * Memory mapped by the arena, and the part of it backed by reserved huge pages.
+         */
+        size_t getMappedSize() const
+        {
+            size_t size = 0;
+            for (const Block& block : this->blocks) {
+                size += block.size;
+            }
+            return size;
+        }
+
+        size_t getHugePagesSize() const
+        {
+            size_t size = 0;
+            for (const Block& block : this->blocks) {
+                size += block.hugePages ? block.size : 0;
+            }
+            return size;
+        }
+
+};
+
+/**
+ * Standard allocator drawing from an arena, deallocation is left to Arena::rewind.
+ * Without an arena it falls back to the heap. Containers carry their allocator along
+ * when assigned or swapped, so a grid copied from an arena one lives in the same arena.
+ * Allocations are aligned to a cache line, so the buffers of two workers never share one.
+ * Resizing leaves the new elements default initialized, without zeroing trivial ones
+ * element by element: the buffers are filled in bulk once sized.
+ */
+template <typename T>
+class ArenaAllocator {
+
+    public:
+
+        using value_type = T;
+
+        using propagate_on_container_copy_assignment = true_type;
+
+        using propagate_on_container_move_assignment = true_type;
+
+        using propagate_on_container_swap = true_type;
+
+        Arena* arena = nullptr;
+
+        ArenaAllocator() = default;
+
+        ArenaAllocator(Arena* arena)
+            : arena(arena)
+        {
+        }
+
+        template <typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other)
+            : arena(other.arena)
+        {
+        }
+
+        T* allocate(size_t count)
+        {
+            if (this->arena == nullptr) {
+                return allocator<T>().allocate(count);
+            }
+            return static_cast<T*>(this->arena->allocate(count * sizeof(T), max(alignof(T), size_t(64))));
+        }
+
+        void deallocate(T* pointer, size_t count)
+        {
+            if (this->arena == nullptr) {
+                allocator<T>().deallocate(pointer, count);
+            }
+        }
+
+        template <typename U>
+        void construct(U* pointer) noexcept(is_nothrow_default_constructible<U>::value)
+        {
+            ::new (static_cast<void*>(pointer)) U;
+        }
+
+        template <typename U, typename... Arguments>
+        void construct(U* pointer, Arguments&&... arguments)
+        {
+            ::new (static_cast<void*>(pointer)) U(forward<Arguments>(arguments)...);
+        }
+
+        template <typename U>
+        bool operator==(const ArenaAllocator<U>& other) const
+        {
+            return this->arena == other.arena;
+        }
+
+        template <typename U>
+        bool operator!=(const ArenaAllocator<U>& other) const
+        {
+            return this->arena != other.arena;
+        }
+
+};
+
+template <typename T>
+using ArenaVector = vector<T, ArenaAllocator<T>>;
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef BUFFERED_WRITER_H
+#define BUFFERED_WRITER_H
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * The buffered writer gathers small writes in a large buffer and hands it to the
+ * file in one call once full, so writing many small records costs a few system calls.
+ */
+class BufferedWriter {
+
+    private:
+
+        FILE* file;
+
+        string filename;
+
+        vector<char> buffer;
+
+        /**
+         * Determines if the file is closed with the writer, false for the standard streams.
+         */
+        bool ownsFile = true;
+
+        size_t used = 0;
+
+    public:
+
+        /**
+         * Constructor, truncates the file.
+         */
+        BufferedWriter(const string& filename, size_t bufferSize = 1 << 20)
+            : filename(filename), buffer(bufferSize)
+        {
+            this->file = fopen(filename.c_str(), "wb");
+            if (this->file == nullptr) {
+                throw runtime_error("ERROR: Could not open " + filename + " for writing.");
+            }
+        }
+
+        /**
+         * Constructor for an already open file, such as stdout, left open on destruction.
+         */
+        BufferedWriter(FILE* file, const string& filename, size_t bufferSize = 1 << 20)
+            : file(file), filename(filename), buffer(bufferSize), ownsFile(false)
+        {
+        }
+
+        ~BufferedWriter()
+        {
+            try {
+                this->flush();
+            } catch (const exception&) {
+            }
+            if (this->ownsFile) {
+                fclose(this->file);
+            }
+        }
+
+        BufferedWriter(const BufferedWriter&) = delete;
+
+        BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+        void write(const void* data, size_t size)
+        {
+            const char* bytes = static_cast<const char*>(data);
+            if (this->used + size > this->buffer.size()) {
+                this->flush();
+                if (size >= this->buffer.size()) {
+                    this->writeToFile(bytes, size);
+                    return;
+                }
+            }
+            memcpy(this->buffer.data() + this->used, bytes, size);
+            this->used += size;
+        }
+
+        void write(const string& text)
+        {
+            this->write(text.data(), text.size());
+        }
+
+        /**
+         * Hand the buffered bytes to the file.
+         */
+        void flush()
+        {
+            if (this->used > 0) {
+                size_t size = this->used;
+                this->used = 0;
+                this->writeToFile(this->buffer.data(), size);
+            }
+            fflush(this->file);
+        }
+
+    private:
+
+        void writeToFile(const char* bytes, size_t size)
+        {
+            if (fwrite(bytes, 1, size, this->file) != size) {
+                throw runtime_error("ERROR: Could not write to " + this->filename + ".");
+            }
+        }
+
+};
+
+#endif
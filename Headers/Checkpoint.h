@@ -0,0 +1,214 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "GridStorage.h"
+#include "PopulationGrid.h"
+
+using namespace std;
+
+/**
+ * A checkpoint holds everything needed to continue a run: a fixed size CheckpointHeader
+ * followed by the raw population grid, halo included, in the layout of its storage.
+ * The random streams are counter based, so the seed, run and generation restore them.
+ *
+ * Checkpoints are written through a shared memory mapping of the file: the grid is
+ * copied once into the page cache, without any serialization or user space buffer.
+ * The file is written next to the previous checkpoint, flushed to the disk and exchanged
+ * with it, then the directory is flushed too, so neither a killed process nor a power loss
+ * leaves a partial one. The next checkpoint overwrites the previous one's pages instead of
+ * allocating new ones.
+ */
+class Checkpoint {
+
+    public:
+
+        struct CheckpointHeader {
+            char magic[4] = {'P', 'S', 'C', 'K'};
+            uint32_t version = 1;
+            uint32_t populationMatrixSize = 0;
+            uint32_t storage = 0;
+            uint64_t seed = 0;
+            uint64_t run = 0;
+            uint64_t generation = 0;
+            uint32_t runCount = 0;
+            uint32_t generationCount = 0;
+            double contagionFactor = 0.0;
+            double initialContagionFactor = 0.0;
+            uint32_t socialDistanceEffect = 0;
+            uint32_t reserved = 0;
+            uint64_t gridSize = 0;
+        };
+
+        static_assert(sizeof(CheckpointHeader) == 80, "The checkpoint header layout must not depend on the compiler.");
+
+    private:
+
+        /**
+         * A file mapped in memory, unmapped and closed on destruction.
+         */
+        class MappedFile {
+
+            public:
+
+                int descriptor = -1;
+
+                void* data = MAP_FAILED;
+
+                size_t size = 0;
+
+                MappedFile(const string& filename, bool writable, size_t size = 0)
+                {
+                    this->descriptor = writable ? open(filename.c_str(), O_RDWR | O_CREAT, 0644) : open(filename.c_str(), O_RDONLY);
+                    if (this->descriptor < 0) {
+                        throw runtime_error("ERROR: Could not open checkpoint " + filename + ": " + strerror(errno) + ".");
+                    }
+                    if (writable) {
+                        if (ftruncate(this->descriptor, static_cast<off_t>(size)) != 0) {
+                            throw runtime_error("ERROR: Could not resize checkpoint " + filename + ": " + strerror(errno) + ".");
+                        }
+                    } else {
+                        struct stat status;
+                        if (fstat(this->descriptor, &status) != 0) {
+                            throw runtime_error("ERROR: Could not read checkpoint " + filename + ": " + strerror(errno) + ".");
+                        }
+                        size = static_cast<size_t>(status.st_size);
+                    }
+                    this->size = size;
+                    if (size < sizeof(CheckpointHeader)) {
+                        throw invalid_argument("ERROR: " + filename + " is not a checkpoint.");
+                    }
+                    this->data = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED | (writable ? MAP_POPULATE : 0), this->descriptor, 0);
+                    if (this->data == MAP_FAILED) {
+                        throw runtime_error("ERROR: Could not map checkpoint " + filename + ": " + strerror(errno) + ".");
+                    }
+                }
+
+                ~MappedFile()
+                {
+                    if (this->data != MAP_FAILED) {
+                        munmap(this->data, this->size);
+                    }
+                    if (this->descriptor >= 0) {
+                        close(this->descriptor);
+                    }
+                }
+
+                /**
+                 * Wait until the mapped pages and the file metadata are on the disk.
+                 */
+                void sync(const string& filename)
+                {
+                    if (msync(this->data, this->size, MS_SYNC) != 0 || fsync(this->descriptor) != 0) {
+                        throw runtime_error("ERROR: Could not write checkpoint " + filename + ": " + strerror(errno) + ".");
+                    }
+                }
+
+                MappedFile(const MappedFile&) = delete;
+
+                MappedFile& operator=(const MappedFile&) = delete;
+
+        };
+
+        static CheckpointHeader validateHeader(const string& filename, const MappedFile& file)
+        {
+            CheckpointHeader header;
+            memcpy(&header, file.data, sizeof(header));
+            if (memcmp(header.magic, "PSCK", 4) != 0 || header.version != 1) {
+                throw invalid_argument("ERROR: " + filename + " is not a checkpoint of this version.");
+            }
+            if (header.storage != static_cast<uint32_t>(GridStorage::bytes) && header.storage != static_cast<uint32_t>(GridStorage::packed)) {
+                throw invalid_argument("ERROR: The checkpoint " + filename + " has an unknown grid storage.");
+            }
+            if (file.size != sizeof(header) + header.gridSize) {
+                throw invalid_argument("ERROR: The checkpoint " + filename + " is truncated.");
+            }
+            return header;
+        }
+
+        /**
+         * Wait until the entries of the directory holding a file are on the disk.
+         */
+        static void syncDirectory(const string& filename)
+        {
+            size_t separator = filename.find_last_of('/');
+            const string directory = separator == string::npos ? "." : (separator == 0 ? "/" : filename.substr(0, separator));
+            int descriptor = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+            if (descriptor < 0) {
+                throw runtime_error("ERROR: Could not open the directory of checkpoint " + filename + ": " + strerror(errno) + ".");
+            }
+            int result = fsync(descriptor);
+            int error = errno;
+            close(descriptor);
+            if (result != 0) {
+                throw runtime_error("ERROR: Could not write the directory of checkpoint " + filename + ": " + strerror(error) + ".");
+            }
+        }
+
+    public:
+
+        /**
+         * Write a checkpoint, replacing the previous one.
+         */
+        static void write(const string& filename, CheckpointHeader header, const PopulationGrid& population)
+        {
+            const string temporaryFilename = filename + ".tmp";
+            header.populationMatrixSize = population.getSize();
+            header.storage = static_cast<uint32_t>(population.getStorage());
+            header.gridSize = population.getMemorySize();
+            {
+                MappedFile file(temporaryFilename, true, sizeof(header) + header.gridSize);
+                memcpy(file.data, &header, sizeof(header));
+                memcpy(static_cast<uint8_t*>(file.data) + sizeof(header), population.data(), header.gridSize);
+                file.sync(temporaryFilename);
+            }
+            if (renameat2(AT_FDCWD, temporaryFilename.c_str(), AT_FDCWD, filename.c_str(), RENAME_EXCHANGE) != 0 &&
+                rename(temporaryFilename.c_str(), filename.c_str()) != 0) {
+                throw runtime_error("ERROR: Could not replace checkpoint " + filename + ": " + strerror(errno) + ".");
+            }
+            syncDirectory(filename);
+        }
+
+        /**
+         * Remove a checkpoint and the previous one kept next to it, once there is no run left to continue.
+         */
+        static void remove(const string& filename)
+        {
+            unlink(filename.c_str());
+            unlink((filename + ".tmp").c_str());
+        }
+
+        static CheckpointHeader readHeader(const string& filename)
+        {
+            MappedFile file(filename, false);
+            return validateHeader(filename, file);
+        }
+
+        /**
+         * Restore the population of a checkpoint, the grid must have its size and storage.
+         */
+        static CheckpointHeader read(const string& filename, PopulationGrid& population)
+        {
+            MappedFile file(filename, false);
+            CheckpointHeader header = validateHeader(filename, file);
+            if (header.populationMatrixSize != static_cast<uint32_t>(population.getSize()) ||
+                header.storage != static_cast<uint32_t>(population.getStorage()) ||
+                header.gridSize != population.getMemorySize()) {
+                throw invalid_argument("ERROR: The checkpoint " + filename + " does not match the population size or storage.");
+            }
+            memcpy(population.data(), static_cast<const uint8_t*>(file.data) + sizeof(header), header.gridSize);
+            return header;
+        }
+
+};
+
+#endif
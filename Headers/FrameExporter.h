@@ -0,0 +1,199 @@
+#ifndef FRAME_EXPORTER_H
+#define FRAME_EXPORTER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BufferedWriter.h"
+#include "FrameFormat.h"
+#include "ImageGenerator.h"
+#include "Profiler.h"
+#include "PopulationGrid.h"
+
+using namespace std;
+
+/**
+ * The frame exporter saves the population every given number of generations.
+ * Capturing a frame only copies the states into a ring buffer slot, a background thread
+ * encodes them, so the simulation only waits when the encoder is a whole ring behind.
+ */
+class FrameExporter {
+
+    private:
+
+        struct Frame {
+            uint64_t generation = 0;
+            vector<uint8_t> states;
+        };
+
+        /**
+         * Generations between two frames.
+         */
+        int interval;
+
+        FrameFormat format;
+
+        /**
+         * Output filename without extension.
+         */
+        string prefix;
+
+        int size = 0;
+
+        vector<Frame> ring;
+
+        /**
+         * Frames captured and frames encoded so far, the slot of a frame is its number modulo the ring size.
+         */
+        uint64_t capturedFrames = 0;
+
+        uint64_t encodedFrames = 0;
+
+        bool stopping = false;
+
+        mutex lock;
+
+        condition_variable frameCaptured;
+
+        condition_variable frameEncoded;
+
+        /**
+         * Raw RGB output, all the frames in one file.
+         */
+        unique_ptr<BufferedWriter> rawWriter;
+
+        thread encoderThread;
+
+        void encoderLoop()
+        {
+            vector<unsigned char> pixels;
+            while (true) {
+                Frame* frame;
+                {
+                    unique_lock<mutex> guard(this->lock);
+                    this->frameCaptured.wait(guard, [this]() {
+                        return this->stopping || this->encodedFrames < this->capturedFrames;
+                    });
+                    if (this->encodedFrames == this->capturedFrames) {
+                        return;
+                    }
+                    frame = &this->ring[this->encodedFrames % this->ring.size()];
+                }
+
+                this->encode(*frame, pixels);
+
+                {
+                    lock_guard<mutex> guard(this->lock);
+                    this->encodedFrames++;
+                }
+                this->frameEncoded.notify_one();
+            }
+        }
+
+        void encode(const Frame& frame, vector<unsigned char>& pixels)
+        {
+            PROFILE_SCOPE(image);
+            if (this->format == FrameFormat::rgb) {
+                pixels.resize(frame.states.size() * 3);
+                ImageGenerator::toRgb(frame.states.data(), frame.states.size(), pixels.data());
+                this->rawWriter->write(pixels.data(), pixels.size());
+                return;
+            }
+            char generation[16];
+            snprintf(generation, sizeof(generation), "%06llu", static_cast<unsigned long long>(frame.generation));
+            string filename = this->prefix + "_" + generation + ".png";
+            if (!ImageGenerator::writePng(filename.c_str(), this->size, this->size, frame.states.data())) {
+                cerr << "ERROR: Failed to save frame as " << filename << endl;
+            }
+        }
+
+    public:
+
+        /**
+         * Constructor, starts the encoder thread.
+         */
+        FrameExporter(int interval, FrameFormat format, const string& prefix, int size, int ringSize = 4)
+            : interval(interval), format(format), prefix(prefix), size(size), ring(ringSize)
+        {
+            if (interval < 1) {
+                throw out_of_range("ERROR: The frames interval must be at least 1.");
+            }
+            if (format == FrameFormat::rgb) {
+                this->rawWriter = make_unique<BufferedWriter>(prefix + "_" + to_string(size) + "x" + to_string(size) + ".rgb");
+            }
+            this->encoderThread = thread([this]() {
+                this->encoderLoop();
+            });
+        }
+
+        ~FrameExporter()
+        {
+            this->close();
+        }
+
+        FrameExporter(const FrameExporter&) = delete;
+
+        FrameExporter& operator=(const FrameExporter&) = delete;
+
+        /**
+         * Copy the population if the generation is one of the exported ones.
+         */
+        void capture(uint64_t generation, const PopulationGrid& population)
+        {
+            if (generation % this->interval != 0) {
+                return;
+            }
+
+            Frame* frame;
+            {
+                unique_lock<mutex> guard(this->lock);
+                this->frameEncoded.wait(guard, [this]() {
+                    return this->capturedFrames - this->encodedFrames < this->ring.size();
+                });
+                frame = &this->ring[this->capturedFrames % this->ring.size()];
+            }
+
+            frame->generation = generation;
+            frame->states.resize(static_cast<size_t>(this->size) * this->size);
+            for (int i = 0; i < this->size; ++i) {
+                population.unpackRow(i, 0, this->size, frame->states.data() + static_cast<size_t>(i) * this->size);
+            }
+
+            {
+                lock_guard<mutex> guard(this->lock);
+                this->capturedFrames++;
+            }
+            this->frameCaptured.notify_one();
+        }
+
+        /**
+         * Encode the remaining frames and stop the encoder thread.
+         */
+        void close()
+        {
+            if (!this->encoderThread.joinable()) {
+                return;
+            }
+            {
+                lock_guard<mutex> guard(this->lock);
+                this->stopping = true;
+            }
+            this->frameCaptured.notify_one();
+            this->encoderThread.join();
+            if (this->rawWriter) {
+                this->rawWriter->flush();
+            }
+            cout << "\nFrames saved successfully as " << this->prefix
+                 << (this->format == FrameFormat::rgb ? "_" + to_string(this->size) + "x" + to_string(this->size) + ".rgb" : "_*.png") << endl;
+        }
+
+};
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef FRAME_FORMAT_H
+#define FRAME_FORMAT_H
+
+/**
+ * Output of the frames captured during a simulation.
+ */
+enum class FrameFormat {
+
+    /**
+     * One .png image per frame.
+     */
+    png = 0,
+
+    /**
+     * Every frame in a single file of raw 8 bits RGB pixels, ready for an external video encoder.
+     */
+    rgb = 1
+
+};
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef GRID_STORAGE_H
+#define GRID_STORAGE_H
+
+/**
+ * Memory layout of the population grids.
+ */
+enum class GridStorage {
+
+    /**
+     * One byte per individual, rows are read and written in place.
+     */
+    bytes = 0,
+
+    /**
+     * Two individuals per byte, rows are unpacked to bytes for each update.
+     */
+    packed = 1
+
+};
+
+#endif
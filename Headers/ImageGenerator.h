@@ -1,80 +1,222 @@
 #ifndef IMAGE_GENERATOR_H
 #define IMAGE_GENERATOR_H
 
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
 #include <vector>
 #include <iostream>
 #include <string>
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "lib/StbImageWrite.h"
-#include "Individual.h"
+#include "PopulationGrid.h"
 #include "State.h"
 
 using namespace std;
 
-using Population = vector<vector<Individual>>;
-
+/**
+ * The image generator draws the population with one color per state.
+ * The images are written as 8 bits paletted PNGs: each pixel is the state value itself,
+ * so the states are compressed as they are, without any color conversion, and there is
+ * a third of the RGB data to compress.
+ */
 class ImageGenerator {
 
 public:
 
-    static void generate(const char* name, Population& population) {
+    /**
+     * RGB color of each state value, the values past the last state are never drawn.
+     */
+    static constexpr unsigned char PALETTE[16][3] = {
+        {0, 255, 0}, // Healthy, green
+        {0, 0, 0}, // Isolated, black
+        {255, 255, 0}, // Sick, yellow
+        {255, 0, 0}, // Dead, red
+        {0, 0, 255} // Immune, blue
+    };
+
+    static const int PALETTE_SIZE = 5;
+
+    /**
+     * Convert a row of states, one byte per individual, to RGB pixels with the palette.
+     */
+    static void toRgb(const uint8_t* states, size_t count, unsigned char* pixels) {
+        for (size_t j = 0; j < count; ++j) {
+            memcpy(pixels + j * 3, PALETTE[states[j] & 0x0F], 3);
+        }
+    }
+
+    /**
+     * State drawn for a block of individuals: the most frequent one, ties going to the
+     * highest state value so the rarer states are not hidden by the healthy ones.
+     */
+    static uint8_t getMajorityState(const uint32_t counts[PALETTE_SIZE]) {
+        uint8_t majority = 0;
+        for (uint8_t state = 1; state < PALETTE_SIZE; ++state) {
+            if (counts[state] >= counts[majority]) {
+                majority = state;
+            }
+        }
+        return majority;
+    }
+
+    /**
+     * Whether a width x height image can be written: the compressor takes the length of the
+     * scanlines, a filter byte and a byte per pixel each, as an int.
+     */
+    static bool canWritePng(int width, int height) {
+        return (static_cast<size_t>(width) + 1) * height <= static_cast<size_t>(numeric_limits<int>::max());
+    }
+
+    /**
+     * Write a paletted PNG of width x height states, row by row, each row starting a stride apart.
+     */
+    static bool writePng(const char* name, int width, int height, const uint8_t* states, size_t stride = 0) {
+        if (!canWritePng(width, height)) {
+            cerr << "\nERROR: The image " << name << " is too large to be compressed, use -z to scale it down." << endl;
+            return false;
+        }
+        stride = stride == 0 ? width : stride;
+        // Each row starts with its filter type, 0 (none) being the advised one for paletted images.
+        const size_t rowSize = static_cast<size_t>(width) + 1;
+        vector<unsigned char> filteredRows(rowSize * height);
+        for (int i = 0; i < height; ++i) {
+            filteredRows[i * rowSize] = 0;
+            memcpy(&filteredRows[i * rowSize + 1], states + i * stride, width);
+        }
+
+        int compressedSize;
+        unsigned char* compressedRows = stbi_zlib_compress(filteredRows.data(), static_cast<int>(filteredRows.size()),
+                                                           &compressedSize, stbi_write_png_compression_level);
+        if (compressedRows == nullptr) {
+            return false;
+        }
+
+        FILE* file = fopen(name, "wb");
+        if (file == nullptr) {
+            free(compressedRows);
+            return false;
+        }
+
+        static const unsigned char SIGNATURE[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+        unsigned char header[13];
+        putBigEndian(header, width);
+        putBigEndian(header + 4, height);
+        header[8] = 8; // Bits per pixel.
+        header[9] = 3; // Paletted color.
+        header[10] = 0; // Deflate compression.
+        header[11] = 0; // Adaptive filtering.
+        header[12] = 0; // No interlace.
+
+        bool written = fwrite(SIGNATURE, 1, sizeof(SIGNATURE), file) == sizeof(SIGNATURE);
+        written = written && writeChunk(file, "IHDR", header, sizeof(header));
+        written = written && writeChunk(file, "PLTE", &PALETTE[0][0], PALETTE_SIZE * 3);
+        written = written && writeChunk(file, "IDAT", compressedRows, compressedSize);
+        written = written && writeChunk(file, "IEND", nullptr, 0);
+        written = fclose(file) == 0 && written;
+        free(compressedRows);
+        return written;
+    }
+
+    /**
+     * Draw the population, one pixel per scale x scale block of individuals with its majority state.
+     * The grid is read one row at a time, so only the image itself is kept in memory.
+     */
+    static void generate(const char* name, const PopulationGrid& population, int scale = 1) {
         // Get the population matrix dimensions
-        const int lines = static_cast<int>(population.size());
-        const int columns = static_cast<int>(population[0].size());
-
-        // Create an RGB buffer to store the image
-        vector<unsigned char> imageBuffer(lines * columns * 3, 0);
-
-        // Iterate over the population matrix and set pixel colors based on the individual's state
-        for (int i = 0; i < lines; ++i) {
-            for (int j = 0; j < columns; ++j) {
-                int index = (i * columns + j) * 3; // Calculate the buffer index
-
-                switch (population[i][j].state) {
-                    case State::healthy:
-                        imageBuffer[index + 0] = 0; // Red
-                        imageBuffer[index + 1] = 255; // Green
-                        imageBuffer[index + 2] = 0; // Blue
-                        break;
-
-                    case State::isolated:
-                        imageBuffer[index + 0] = 0;
-                        imageBuffer[index + 1] = 0;
-                        imageBuffer[index + 2] = 0;
-                        break;
-
-                    case State::sick:
-                        imageBuffer[index + 0] = 255;
-                        imageBuffer[index + 1] = 255;
-                        imageBuffer[index + 2] = 0;
-                        break;
-
-                    case State::dead:
-                        imageBuffer[index + 0] = 255;
-                        imageBuffer[index + 1] = 0;
-                        imageBuffer[index + 2] = 0;
-                        break;
-
-                    case State::immune:
-                        imageBuffer[index + 0] = 0;
-                        imageBuffer[index + 1] = 0;
-                        imageBuffer[index + 2] = 255;
-                        break;
-
-                    default:
-                        cerr << "ERROR: INVALID STATE ON IMAGE GENERATION" << endl;
-                        break;
+        const int size = population.getSize();
+        const int lines = (size + scale - 1) / scale;
+        const int columns = (size + scale - 1) / scale;
+        // Refused before the pixels are gathered, which would take as much memory as the grid.
+        if (!canWritePng(columns, lines)) {
+            cerr << "\nERROR: The image " << name << " is too large to be compressed, use -z to scale it down." << endl;
+            return;
+        }
+
+        // One byte per pixel, the state being the palette index
+        vector<uint8_t> states(static_cast<size_t>(lines) * columns);
+        if (scale == 1) {
+            for (int i = 0; i < lines; ++i) {
+                population.unpackRow(i, 0, columns, states.data() + static_cast<size_t>(i) * columns);
+            }
+        } else {
+            vector<uint8_t> row(size);
+            vector<uint32_t> counts(static_cast<size_t>(columns) * PALETTE_SIZE);
+            for (int i = 0; i < size; ++i) {
+                population.unpackRow(i, 0, size, row.data());
+                for (int j = 0; j < size; ++j) {
+                    counts[(j / scale) * PALETTE_SIZE + row[j]]++;
+                }
+                if ((i + 1) % scale == 0 || i == size - 1) {
+                    uint8_t* pixels = states.data() + static_cast<size_t>(i / scale) * columns;
+                    for (int j = 0; j < columns; ++j) {
+                        pixels[j] = getMajorityState(&counts[j * PALETTE_SIZE]);
+                    }
+                    fill(counts.begin(), counts.end(), 0);
                 }
             }
         }
 
-        if (stbi_write_png(name, columns, lines, 3, imageBuffer.data(), columns * 3)) {
+        if (writePng(name, columns, lines, states.data())) {
             cout << "\nImage saved successfully as " << name << endl;
         } else {
             cerr << "\nERROR: Failed to save image as " << name << endl;
         }
     }
 
+private:
+
+    static void putBigEndian(unsigned char* bytes, uint32_t value) {
+        bytes[0] = static_cast<unsigned char>(value >> 24);
+        bytes[1] = static_cast<unsigned char>(value >> 16);
+        bytes[2] = static_cast<unsigned char>(value >> 8);
+        bytes[3] = static_cast<unsigned char>(value);
+    }
+
+    /**
+     * CRC-32 of each byte value, as used by the PNG chunks.
+     */
+    static const uint32_t* getCrcTable() {
+        static const vector<uint32_t> table = []() {
+            vector<uint32_t> values(256);
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t crc = n;
+                for (int k = 0; k < 8; ++k) {
+                    crc = crc & 1 ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+                }
+                values[n] = crc;
+            }
+            return values;
+        }();
+        return table.data();
+    }
+
+    static uint32_t updateCrc(uint32_t crc, const unsigned char* bytes, size_t size) {
+        const uint32_t* table = getCrcTable();
+        for (size_t i = 0; i < size; ++i) {
+            crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+    /**
+     * Write a PNG chunk: length, type, data and the CRC of the type and data.
+     */
+    static bool writeChunk(FILE* file, const char type[4], const unsigned char* data, size_t size) {
+        unsigned char length[4];
+        unsigned char crc[4];
+        putBigEndian(length, static_cast<uint32_t>(size));
+        uint32_t checksum = updateCrc(0xFFFFFFFFu, reinterpret_cast<const unsigned char*>(type), 4);
+        checksum = updateCrc(checksum, data, size);
+        putBigEndian(crc, checksum ^ 0xFFFFFFFFu);
+        return fwrite(length, 1, 4, file) == 4 &&
+               fwrite(type, 1, 4, file) == 4 &&
+               (size == 0 || fwrite(data, 1, size, file) == size) &&
+               fwrite(crc, 1, 4, file) == 4;
+    }
+
 };
 
 #endif
@@ -1,6 +1,7 @@
 #ifndef MULTITHREADING_CONTROLLER_H
 #define MULTITHREADING_CONTROLLER_H
 
+#include <stdexcept>
 #include <thread>
 
 using namespace std;
@@ -19,6 +20,20 @@ class MultithreadingController {
             return MultithreadingController::getCurrentProcessorAvailableThreads() > 1;
         }
 
+        /**
+         * Check that the current processor can run the requested threads count, for every multi-threaded mode.
+         */
+        static void throwIfThreadCountIsNotSupported(int threadCount)
+        {
+            int availableThreads = MultithreadingController::getCurrentProcessorAvailableThreads();
+            if(threadCount > 1 && availableThreads == 0) {
+                throw out_of_range("ERROR: THE CURRENT PROCESSOR DOES NOT SUPPORTS MULTITHREADING, PLEASE REMOVE THE '-t' PARAM.");
+            }
+            if(threadCount > availableThreads && availableThreads > 0) {
+                throw out_of_range("ERROR: THE REQUESTED THREADS COUNT EXCEEDS THE CURRENT PROCESSOR AVAILABLE THREADS.");
+            }
+        }
+
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,68 @@
+#ifndef NEIGHBOUR_STENCIL_H
+#define NEIGHBOUR_STENCIL_H
+
+#include <cstdint>
+#include "PopulationGrid.h"
+#include "State.h"
+
+/**
+ * The neighbour stencil counts the sick and isolated individuals of each 3x3 neighbourhood.
+ * Both counts are packed in one byte: sick individuals in the low nibble, isolated ones in
+ * the high nibble. The grid halo makes the border cells branch free.
+ */
+class NeighbourStencil {
+
+    public:
+
+        /**
+         * Contribution of one individual to a packed count.
+         */
+        static uint8_t weight(uint8_t state)
+        {
+            return static_cast<uint8_t>((state == static_cast<uint8_t>(State::sick)) |
+                                        ((state == static_cast<uint8_t>(State::isolated)) << 4));
+        }
+
+        static int getSickCount(uint8_t counts)
+        {
+            return counts & 0x0F;
+        }
+
+        static int getIsolatedCount(uint8_t counts)
+        {
+            return counts >> 4;
+        }
+
+        /**
+         * Packed counts of a row segment of count individuals, written from counts[0].
+         * The three rows are indexed from the first individual of the segment, and must be
+         * readable from index -1 to index count, as given by PopulationGrid::readRow.
+         */
+        static void countRow(const uint8_t* above, const uint8_t* current, const uint8_t* below, int count, uint8_t* counts)
+        {
+            for (int j = 0; j < count; ++j) {
+                counts[j] = static_cast<uint8_t>(
+                    weight(above[j - 1]) + weight(above[j]) + weight(above[j + 1]) +
+                    weight(current[j - 1]) + weight(current[j]) + weight(current[j + 1]) +
+                    weight(below[j - 1]) + weight(below[j]) + weight(below[j + 1])
+                );
+            }
+        }
+
+        /**
+         * Packed counts of a single individual.
+         */
+        static uint8_t countCell(const PopulationGrid& population, int line, int column)
+        {
+            uint8_t counts = 0;
+            for (int i = line - 1; i <= line + 1; ++i) {
+                for (int j = column - 1; j <= column + 1; ++j) {
+                    counts += weight(static_cast<uint8_t>(population.get(i, j)));
+                }
+            }
+            return counts;
+        }
+
+};
+
+#endif
@@ -0,0 +1,291 @@
+#ifndef POPULATION_GRID_H
+#define POPULATION_GRID_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "Arena.h"
+#include "GridStorage.h"
+#include "State.h"
+
+using namespace std;
+
+/**
+ * The population grid stores the individuals states in a single contiguous buffer.
+ * Rows are laid out one after another, each one starting a row stride apart.
+ * The grid is surrounded by a one cell halo of healthy individuals that is never written,
+ * so lines -1 and size, and columns -1 and size, can be read without bounds checks.
+ *
+ * With byte storage each individual takes one byte and rows are accessed in place.
+ * With packed storage each individual takes a nibble, even columns in the low one, and the
+ * bulk kernels unpack row segments to bytes and pack them back. Rows keep two halo nibbles
+ * on the left so every even column starts a byte: segments starting on even columns never
+ * share a byte, and can be packed by different threads.
+ */
+class PopulationGrid {
+
+    private:
+
+        /**
+         * The grid side length.
+         */
+        int size;
+
+        /**
+         * Distance, in bytes, between the start of two consecutive rows.
+         */
+        int stride;
+
+        GridStorage storage;
+
+        /**
+         * The individuals states, row by row, halo included.
+         */
+        ArenaVector<uint8_t> cells;
+
+        size_t offset(int line, int column) const
+        {
+            return static_cast<size_t>(line + 1) * this->stride + (column + 1);
+        }
+
+        /**
+         * Packed storage: position of a column nibble inside its row.
+         */
+        static int nibble(int column)
+        {
+            return column + 2;
+        }
+
+        const uint8_t* packedRow(int line) const
+        {
+            return this->cells.data() + static_cast<size_t>(line + 1) * this->stride;
+        }
+
+        uint8_t* packedRow(int line)
+        {
+            return this->cells.data() + static_cast<size_t>(line + 1) * this->stride;
+        }
+
+        static int strideOf(int size, GridStorage storage)
+        {
+            return storage == GridStorage::packed ? (nibble(size + 1) + 2) / 2 : size + 2;
+        }
+
+    public:
+
+        /**
+         * Constructor.
+         * The states are allocated from the arena when one is given, and from the heap otherwise.
+         */
+        PopulationGrid(int size = 0, State initialState = State::healthy, GridStorage storage = GridStorage::bytes, Arena* arena = nullptr)
+            : size(size), storage(storage), cells(ArenaAllocator<uint8_t>(arena))
+        {
+            this->stride = strideOf(size, storage);
+            this->cells.resize(memorySizeOf(size, storage));
+            this->fill(State::healthy);
+            if (initialState != State::healthy) {
+                this->fill(initialState);
+            }
+        }
+
+        int getSize() const
+        {
+            return this->size;
+        }
+
+        int getStride() const
+        {
+            return this->stride;
+        }
+
+        GridStorage getStorage() const
+        {
+            return this->storage;
+        }
+
+        bool isPacked() const
+        {
+            return this->storage == GridStorage::packed;
+        }
+
+        /**
+         * Memory used by the states of a grid of the given size and storage, halo included.
+         */
+        static size_t memorySizeOf(int size, GridStorage storage)
+        {
+            return static_cast<size_t>(size + 2) * strideOf(size, storage);
+        }
+
+        /**
+         * Memory used by the states, halo included.
+         */
+        size_t getMemorySize() const
+        {
+            return this->cells.size();
+        }
+
+        /**
+         * Raw states, halo included, getMemorySize() bytes in the layout of the storage.
+         */
+        uint8_t* data()
+        {
+            return this->cells.data();
+        }
+
+        const uint8_t* data() const
+        {
+            return this->cells.data();
+        }
+
+        State get(int line, int column) const
+        {
+            if (this->isPacked()) {
+                int position = nibble(column);
+                return static_cast<State>((this->packedRow(line)[position >> 1] >> ((position & 1) * 4)) & 0x0F);
+            }
+            return static_cast<State>(this->cells[this->offset(line, column)]);
+        }
+
+        void set(int line, int column, State state)
+        {
+            if (this->isPacked()) {
+                int position = nibble(column);
+                uint8_t& cell = this->packedRow(line)[position >> 1];
+                int shift = (position & 1) * 4;
+                cell = static_cast<uint8_t>((cell & ~(0x0F << shift)) | (static_cast<uint8_t>(state) << shift));
+                return;
+            }
+            this->cells[this->offset(line, column)] = static_cast<uint8_t>(state);
+        }
+
+        /**
+         * Byte storage only: raw access to the first cell of a row, from -1 to size for the halo rows.
+         * Indices -1 and size of the returned row are its halo cells.
+         */
+        uint8_t* row(int line)
+        {
+            return this->cells.data() + this->offset(line, 0);
+        }
+
+        const uint8_t* row(int line) const
+        {
+            return this->cells.data() + this->offset(line, 0);
+        }
+
+        /**
+         * Bulk unpack of the columns [startColumn, endColumn) of a line, one byte per individual.
+         * Byte storage rows are copied as they are.
+         */
+        void unpackRow(int line, int startColumn, int endColumn, uint8_t* states) const
+        {
+            if (!this->isPacked()) {
+                copy(this->row(line) + startColumn, this->row(line) + endColumn, states);
+                return;
+            }
+            const uint8_t* bytes = this->packedRow(line);
+            int position = nibble(startColumn);
+            const int end = nibble(endColumn);
+            if (position < end && (position & 1)) {
+                *states++ = bytes[position >> 1] >> 4;
+                position++;
+            }
+            for (; position + 1 < end; position += 2) {
+                uint8_t pair = bytes[position >> 1];
+                states[0] = pair & 0x0F;
+                states[1] = pair >> 4;
+                states += 2;
+            }
+            if (position < end) {
+                *states = bytes[position >> 1] & 0x0F;
+            }
+        }
+
+        /**
+         * Bulk pack of the columns [startColumn, endColumn) of a line.
+         */
+        void packRow(int line, int startColumn, int endColumn, const uint8_t* states)
+        {
+            uint8_t* bytes = this->packedRow(line);
+            int position = nibble(startColumn);
+            const int end = nibble(endColumn);
+            if (position < end && (position & 1)) {
+                bytes[position >> 1] = static_cast<uint8_t>((bytes[position >> 1] & 0x0F) | (*states++ << 4));
+                position++;
+            }
+            for (; position + 1 < end; position += 2) {
+                bytes[position >> 1] = static_cast<uint8_t>(states[0] | (states[1] << 4));
+                states += 2;
+            }
+            if (position < end) {
+                bytes[position >> 1] = static_cast<uint8_t>((bytes[position >> 1] & 0xF0) | *states);
+            }
+        }
+
+        /**
+         * States of the columns [startColumn - 1, endColumn + 1) of a line, halo included, indexed
+         * from startColumn. Byte storage points into the grid, packed storage unpacks into the
+         * scratch buffer, which must hold endColumn - startColumn + 2 bytes.
+         */
+        const uint8_t* readRow(int line, int startColumn, int endColumn, uint8_t* scratch) const
+        {
+            if (!this->isPacked()) {
+                return this->row(line) + startColumn;
+            }
+            this->unpackRow(line, startColumn - 1, endColumn + 1, scratch);
+            return scratch + 1;
+        }
+
+        /**
+         * Destination of the columns [startColumn, endColumn) of a line, indexed from startColumn.
+         * Byte storage points into the grid, packed storage into the scratch buffer, which
+         * commitRow packs back.
+         */
+        uint8_t* writeRow(int line, int startColumn, uint8_t* scratch)
+        {
+            return this->isPacked() ? scratch : this->row(line) + startColumn;
+        }
+
+        void commitRow(int line, int startColumn, int endColumn, const uint8_t* scratch)
+        {
+            if (this->isPacked()) {
+                this->packRow(line, startColumn, endColumn, scratch);
+            }
+        }
+
+        /**
+         * Exchange the contents of two grids in constant time.
+         */
+        void swap(PopulationGrid& other)
+        {
+            std::swap(this->size, other.size);
+            std::swap(this->stride, other.stride);
+            std::swap(this->storage, other.storage);
+            this->cells.swap(other.cells);
+        }
+
+        /**
+         * Set every individual to the given state, the halo stays healthy.
+         * Healthy grids, halo included, are filled as a single block.
+         */
+        void fill(State state)
+        {
+            if (state == State::healthy) {
+                uint8_t healthy = static_cast<uint8_t>(State::healthy);
+                std::fill(this->cells.begin(), this->cells.end(), this->isPacked() ? static_cast<uint8_t>(healthy | healthy << 4) : healthy);
+                return;
+            }
+            if (this->isPacked()) {
+                vector<uint8_t> states(this->size, static_cast<uint8_t>(state));
+                for (int i = 0; i < this->size; ++i) {
+                    this->packRow(i, 0, this->size, states.data());
+                }
+                return;
+            }
+            for (int i = 0; i < this->size; ++i) {
+                std::fill(this->row(i), this->row(i) + this->size, static_cast<uint8_t>(state));
+            }
+        }
+
+};
+
+#endif
@@ -0,0 +1,265 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+/**
+ * Build with -DPANDEMIC_SIM_PROFILING=0 to compile the profiling scopes out entirely.
+ * Otherwise a disabled profiler costs one branch per scope, and the scopes are placed
+ * around whole generations, never around individuals.
+ */
+#ifndef PANDEMIC_SIM_PROFILING
+#define PANDEMIC_SIM_PROFILING 1
+#endif
+
+/**
+ * The profiler accumulates the wall time spent in each phase of the simulation, the busy
+ * and idle time of each thread pool worker, and the individuals updated, from every thread.
+ */
+class Profiler {
+
+    public:
+
+        enum Phase {
+            construction = 0,
+            update = 1,
+            swap = 2,
+            counting = 3,
+            checkpoint = 4,
+            image = 5,
+            PHASE_COUNT = 6
+        };
+
+        static constexpr int MAX_WORKERS = 256;
+
+    private:
+
+        /**
+         * Time spent running pool tasks by one worker, padded so workers never share a cache line.
+         */
+        struct alignas(64) WorkerTime {
+            atomic<uint64_t> busyNanoseconds{0};
+        };
+
+        bool enabled = false;
+
+        chrono::steady_clock::time_point start;
+
+        atomic<uint64_t> phaseNanoseconds[PHASE_COUNT] = {};
+
+        atomic<uint64_t> phaseCalls[PHASE_COUNT] = {};
+
+        atomic<uint64_t> updatedCells{0};
+
+        /**
+         * Wall time of the pool tasks, from publication to the barrier.
+         */
+        atomic<uint64_t> poolNanoseconds{0};
+
+        atomic<int> workerCount{0};
+
+        unique_ptr<WorkerTime[]> workers{new WorkerTime[MAX_WORKERS]};
+
+        static const char* getPhaseName(int phase)
+        {
+            static const char* const NAMES[PHASE_COUNT] = {
+                "construction", "update", "swap", "counting", "checkpoint", "image"
+            };
+            return NAMES[phase];
+        }
+
+        double getElapsedSeconds() const
+        {
+            return chrono::duration<double>(chrono::steady_clock::now() - this->start).count();
+        }
+
+    public:
+
+        static Profiler& getInstance()
+        {
+            static Profiler profiler;
+            return profiler;
+        }
+
+        static uint64_t now()
+        {
+            return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        /**
+         * Start recording, must be called before any simulation thread starts.
+         */
+        void enable()
+        {
+            this->enabled = true;
+            this->start = chrono::steady_clock::now();
+        }
+
+        bool isEnabled() const
+        {
+            return this->enabled;
+        }
+
+        void record(Phase phase, uint64_t nanoseconds)
+        {
+            this->phaseNanoseconds[phase].fetch_add(nanoseconds, memory_order_relaxed);
+            this->phaseCalls[phase].fetch_add(1, memory_order_relaxed);
+        }
+
+        void addUpdatedCells(uint64_t cells)
+        {
+            if (this->enabled) {
+                this->updatedCells.fetch_add(cells, memory_order_relaxed);
+            }
+        }
+
+        void recordWorker(int worker, uint64_t busyNanoseconds)
+        {
+            if (worker < MAX_WORKERS) {
+                this->workers[worker].busyNanoseconds.fetch_add(busyNanoseconds, memory_order_relaxed);
+            }
+        }
+
+        /**
+         * Record one pool task, run by the given number of workers.
+         */
+        void recordPoolTask(int taskWorkers, uint64_t nanoseconds)
+        {
+            this->poolNanoseconds.fetch_add(nanoseconds, memory_order_relaxed);
+            int seen = this->workerCount.load(memory_order_relaxed);
+            while (seen < taskWorkers && !this->workerCount.compare_exchange_weak(seen, taskWorkers, memory_order_relaxed)) {
+            }
+        }
+
+        /**
+         * Print the phases and workers tables.
+         */
+        void printReport(ostream& output) const
+        {
+            const double elapsed = this->getElapsedSeconds();
+            output << "\n-------------------------------------------------------------------------------------------" << endl;
+#if !PANDEMIC_SIM_PROFILING
+            output << "-- Profiling was compiled out (PANDEMIC_SIM_PROFILING=0), only the total time is known." << endl;
+#endif
+            output << "-- Profile, " << fixed << setprecision(3) << elapsed << " s in total" << endl;
+            output << left << setw(16) << "Phase" << right << setw(12) << "Calls" << setw(14) << "Total (s)"
+                   << setw(14) << "Mean (ms)" << setw(10) << "Share" << endl;
+            for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+                uint64_t calls = this->phaseCalls[phase].load();
+                double seconds = this->phaseNanoseconds[phase].load() * 1e-9;
+                output << left << setw(16) << getPhaseName(phase) << right << setw(12) << calls
+                       << setw(14) << setprecision(3) << seconds
+                       << setw(14) << (calls > 0 ? seconds * 1e3 / calls : 0.0)
+                       << setw(9) << setprecision(1) << (elapsed > 0.0 ? 100.0 * seconds / elapsed : 0.0) << "%" << endl;
+            }
+            double updateSeconds = this->phaseNanoseconds[update].load() * 1e-9;
+            output << "-- Individuals updated: " << this->updatedCells.load() << ", "
+                   << scientific << setprecision(3) << (updateSeconds > 0.0 ? this->updatedCells.load() / updateSeconds : 0.0)
+                   << fixed << " per second of update" << endl;
+
+            const int count = this->workerCount.load();
+            if (count > 0) {
+                const double poolSeconds = this->poolNanoseconds.load() * 1e-9;
+                output << left << setw(16) << "Worker" << right << setw(12) << "Busy (s)" << setw(14) << "Idle (s)" << setw(14) << "Busy" << endl;
+                for (int worker = 0; worker < min(count, MAX_WORKERS); ++worker) {
+                    double busy = this->workers[worker].busyNanoseconds.load() * 1e-9;
+                    output << left << setw(16) << worker << right << setprecision(3) << setw(12) << busy
+                           << setw(14) << max(poolSeconds - busy, 0.0)
+                           << setw(13) << setprecision(1) << (poolSeconds > 0.0 ? 100.0 * busy / poolSeconds : 0.0) << "%" << endl;
+                }
+            }
+            output << "-------------------------------------------------------------------------------------------" << endl;
+            output << defaultfloat;
+        }
+
+        void writeJson(const string& filename) const
+        {
+            ofstream json(filename);
+            const double poolSeconds = this->poolNanoseconds.load() * 1e-9;
+            const double updateSeconds = this->phaseNanoseconds[update].load() * 1e-9;
+            json << setprecision(9);
+            json << "{\n";
+            json << "  \"compiled\": " << (PANDEMIC_SIM_PROFILING ? "true" : "false") << ",\n";
+            json << "  \"total_seconds\": " << this->getElapsedSeconds() << ",\n";
+            json << "  \"phases\": {\n";
+            for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+                json << "    \"" << getPhaseName(phase) << "\": {\"calls\": " << this->phaseCalls[phase].load()
+                     << ", \"seconds\": " << this->phaseNanoseconds[phase].load() * 1e-9 << "}"
+                     << (phase + 1 < PHASE_COUNT ? "," : "") << "\n";
+            }
+            json << "  },\n";
+            json << "  \"updated_cells\": " << this->updatedCells.load() << ",\n";
+            json << "  \"cells_per_second\": " << (updateSeconds > 0.0 ? this->updatedCells.load() / updateSeconds : 0.0) << ",\n";
+            json << "  \"pool_seconds\": " << poolSeconds << ",\n";
+            json << "  \"workers\": [";
+            const int count = min(this->workerCount.load(), MAX_WORKERS);
+            for (int worker = 0; worker < count; ++worker) {
+                double busy = this->workers[worker].busyNanoseconds.load() * 1e-9;
+                json << (worker > 0 ? ", " : "") << "{\"busy_seconds\": " << busy << ", \"idle_seconds\": " << max(poolSeconds - busy, 0.0) << "}";
+            }
+            json << "]\n";
+            json << "}\n";
+            if (!json) {
+                throw runtime_error("ERROR: Could not write the profile to " + filename + ".");
+            }
+        }
+
+};
+
+/**
+ * Adds the wall time of its scope to a phase, when the profiler is enabled.
+ */
+class ProfileScope {
+
+    private:
+
+        Profiler::Phase phase;
+
+        uint64_t start = 0;
+
+    public:
+
+        ProfileScope(Profiler::Phase phase)
+            : phase(phase)
+        {
+            if (Profiler::getInstance().isEnabled()) {
+                this->start = Profiler::now();
+            }
+        }
+
+        ~ProfileScope()
+        {
+            if (this->start != 0) {
+                Profiler::getInstance().record(this->phase, Profiler::now() - this->start);
+            }
+        }
+
+        ProfileScope(const ProfileScope&) = delete;
+
+        ProfileScope& operator=(const ProfileScope&) = delete;
+
+};
+
+#define PROFILE_CONCATENATE_NAME(name, line) name##line
+#define PROFILE_SCOPE_NAME(line) PROFILE_CONCATENATE_NAME(profileScope, line)
+
+#if PANDEMIC_SIM_PROFILING
+#define PROFILE_SCOPE(phase) ProfileScope PROFILE_SCOPE_NAME(__LINE__)(Profiler::phase)
+#define PROFILE_CELLS(cells) Profiler::getInstance().addUpdatedCells(cells)
+#else
+#define PROFILE_SCOPE(phase)
+#define PROFILE_CELLS(cells)
+#endif
+
+#endif
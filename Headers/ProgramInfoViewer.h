@@ -1,6 +1,7 @@
 #ifndef PROGRAM_INFO_VIWER_H
 #define PROGRAM_INFO_VIWER_H
 
+#include <cstdint>
 #include <iostream>
 #include "State.h"
 #include "MultithreadingController.h"
@@ -27,7 +28,7 @@ void printASCIIArt()
 /**
  * ACII art via: https://patorjk.com/software/taag/#p=display&f=Graffiti&t=Pandemic_Sim
  */
-void printHeaders(int intParams[4], bool boolParams[2], double doubleParams[1])
+void printHeaders(int intParams[4], bool boolParams[4], double doubleParams[1], uint64_t seed)
 {
     cout << "-------------------------------------------------------------------------------------------" << endl;
     printASCIIArt();
@@ -37,7 +38,10 @@ void printHeaders(int intParams[4], bool boolParams[2], double doubleParams[1])
     cout << "-- Disease contagion factor: " << doubleParams[0] << endl;
     cout << "-- Social distance effect applyied: " << boolToString(boolParams[0]) << endl;
     cout << "-- Threads: " << intParams[3] << endl;
+    cout << "-- Runs distributed across threads: " << boolToString(boolParams[2]) << endl;
+    cout << "-- Packed grid storage: " << boolToString(boolParams[3]) << endl;
     cout << "-- Generate visual example image on finish: " << boolToString(boolParams[1]) << endl;
+    cout << "-- Seed: " << seed << endl;
     cout << "-------------------------------------------------------------------------------------------" << endl;
     delete[] intParams;
     delete[] boolParams;
@@ -50,7 +54,12 @@ void printHelp()
     cout << "-------------------------------------------------------------------------------------------" << endl;
     cout << "Usage: simulator [-v | --version] [-h | --help] [-r | --runs <value>] [-p | --population <value>]" << endl;
     cout << "                 [-g | --generations <value>] [-s | --social-distance-effect] [-t | --threads <value>]" << endl;
-    cout << "                 [-c | --contagion-factor <value>] [-o | --output-state <value>] [-i | --image]" << endl;
+    cout << "                 [-c | --contagion-factor <value>] [-o | --output-state <value>] [-S | --seed <value>] [-R | --run-parallel]" << endl;
+    cout << "                 [-E | --engine <dense|sparse>] [-P | --packed] [-T | --timeseries <file>]" << endl;
+    cout << "                 [-F | --format <plain|csv|jsonl>] [-f | --frames <value>] [-m | --frames-format <png|rgb>]" << endl;
+    cout << "                 [-i | --image] [-z | --image-scale <value>] [-Z | --image-tiles]" << endl;
+    cout << "                 [-k | --checkpoint <file>] [-K | --checkpoint-interval <value>] [-u | --resume <file>]" << endl;
+    cout << "                 [-x | --profile <file>]" << endl;
     cout << "\n" << endl;
     cout << "Multithreading is available : " << boolToString(MultithreadingController::currentProcessorSupportsMultithreading()) << "." << endl;
     cout << "CPU Threads available       : " << MultithreadingController::getCurrentProcessorAvailableThreads() << "." << endl;
@@ -72,7 +81,21 @@ void printHelp()
     cout << "-t | --threads                :       Run the simulations with a multi-threaded profile. Specifies the number of threads the program may use. The maximum value is the number of threads available on the current processor (integer)." << endl;
     cout << "-c | --contagion-factor       :       Defines the disease contagion factor, minimum 0.1, maximum 1 (double)." << endl;
     cout << "-o | --output-state           :       Defines the state for which you want to obtain the number of affected individuals (integer)." << endl;
+    cout << "-S | --seed                   :       Seed of the random streams. Runs with the same seed give the same results for any threads count (unsigned integer)." << endl;
+    cout << "-R | --run-parallel           :       Distribute whole runs across the '-t' threads instead of splitting each generation. Results are printed in run order." << endl;
+    cout << "-E | --engine                 :       Define how each generation is computed: dense visits every individual, sparse only the infection front. Both give the same results for the same seed." << endl;
+    cout << "-P | --packed                 :       Store two individuals per byte, halving the grids memory for very large populations at some speed cost. Gives the same results." << endl;
+    cout << "-T | --timeseries             :       Write the count of every state at every generation of every run to a binary file (string)." << endl;
+    cout << "-F | --format                 :       Define how the results are printed: plain counts, csv or jsonl (JSON lines) records with the run and state." << endl;
+    cout << "-f | --frames                 :       Save the population of the last run every given number of generations, from generation 0 (integer)." << endl;
+    cout << "-m | --frames-format          :       Define how the '-f' frames are saved: one png image per frame, or every frame in a single raw rgb file." << endl;
     cout << "-i | --image                  :       Generate a visual disease spread example as a .png image." << endl;
+    cout << "-z | --image-scale            :       Draw the '-i' image with one pixel per block of the given side, colored with its most frequent state (integer)." << endl;
+    cout << "-Z | --image-tiles            :       Generate the visual example as a Deep Zoom (.dzi) tile pyramid, for populations too large for a single image." << endl;
+    cout << "-k | --checkpoint             :       Save the state of the current run to the given file every '-K' generations, to continue it later with '-u' (string)." << endl;
+    cout << "-K | --checkpoint-interval    :       Generations between two checkpoints, 10 by default (integer)." << endl;
+    cout << "-u | --resume                 :       Continue the simulation saved in the given checkpoint file, with the parameters it was started with (string)." << endl;
+    cout << "-x | --profile                :       Print the time spent in each phase and by each worker, and save it as JSON to the given file (string)." << endl;
     cout << "---------------------------------------------------------------------------------------------" << endl;
     cout << "Default params: r(100), p(100), p(10), c(0.5), o(3), s(false), t(1), i(false)" << endl;
 }
@@ -3,40 +3,91 @@
 
 #include <random>
 #include <chrono>
-#include <functional>
+#include <cstdint>
 
 /**
- * The number randomization machine returns a random double
- * generated by a uniform continuous distribution.
+ * The number randomization machine is a counter-based generator: every draw is a pure
+ * function of (seed, run, generation, cell, draw index), so any thread can produce any
+ * number without shared state or locks.
  */
 class RandomNumberGenerator {
 
     private:
 
+        uint64_t seed;
+
+    public:
+
+        /**
+         * SplitMix64 finalizer, used to derive independent keys from the seed.
+         * Reference: G. Steele, D. Lea and C. Flood, Fast Splittable Pseudorandom
+         * Number Generators, OOPSLA 2014.
+         */
+        static uint64_t splitMix64(uint64_t value)
+        {
+            value += 0x9E3779B97F4A7C15ull;
+            value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+            value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+            return value ^ (value >> 31);
+        }
+
         /**
-         * The mersenne twister engine is a general-purpose pseudorandom number generator (PRNG).
-         * Reference: M. Matsumoto and T. Nishimura, Mersenne Twister: A 623-Dimensionally
-         * Equidistributed Uniform Pseudo-Random Number Generator, ACM Transactions
-         * on Modeling and Computer Simulation, Vol. 8, No. 1, January 1998, pp 3-30.
-         * Soruce: https://dl.acm.org/doi/abs/10.1145/272991.272995
+         * MurmurHash3 32 bits finalizer, cheap enough to run once per cell.
          */
-        std::mt19937& getGenerator()
+        static uint32_t mix32(uint32_t value)
         {
-            auto timeSeed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+            value ^= value >> 16;
+            value *= 0x85EBCA6Bu;
+            value ^= value >> 13;
+            value *= 0xC2B2AE35u;
+            return value ^ (value >> 16);
+        }
+
+        /**
+         * Seed taken from the clock and the system entropy source.
+         */
+        static uint64_t getEntropySeed()
+        {
+            uint64_t timeSeed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
             std::random_device rd;
-            size_t hashedSeed = std::hash<size_t>()(timeSeed ^ rd());
-            static std::mt19937 gen(hashedSeed);
-            return gen;
+            return splitMix64(timeSeed ^ (static_cast<uint64_t>(rd()) << 32 | rd()));
         }
 
-    public:
+        /**
+         * Constructor.
+         */
+        RandomNumberGenerator(uint64_t seed = getEntropySeed()) : seed(seed) {}
 
-        double getRandomNumber(double minValue = 0, double maxValue = 1)
+        uint64_t getSeed() const
+        {
+            return this->seed;
+        }
+
+        /**
+         * Key shared by every draw of one generation of one run.
+         */
+        uint64_t getGenerationKey(uint64_t run, uint64_t generation) const
+        {
+            return splitMix64(splitMix64(this->seed ^ splitMix64(run)) ^ generation);
+        }
+
+        /**
+         * Uniform 32 bits drawn for the given cell of the keyed generation.
+         */
+        static uint32_t getRandomBits(uint64_t generationKey, uint32_t line, uint32_t column, uint32_t draw = 0)
+        {
+            uint32_t hash = mix32(static_cast<uint32_t>(generationKey) ^ column);
+            return mix32(hash ^ static_cast<uint32_t>(generationKey >> 32) ^ (line * 0x9E3779B9u) ^ (draw * 0x85EBCA77u));
+        }
+
+        /**
+         * Uniform double in [0, 1) drawn for the given cell of the keyed generation.
+         */
+        static double getRandomNumber(uint64_t generationKey, uint32_t line, uint32_t column, uint32_t draw = 0)
         {
-            static std::uniform_real_distribution<> dis(minValue, maxValue);
-            return dis(this->getGenerator());
+            return getRandomBits(generationKey, line, column, draw) * (1.0 / 4294967296.0);
         }
 
 };
 
-#endif
\ No newline at end of file
+#endif
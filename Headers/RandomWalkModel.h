@@ -1,41 +1,105 @@
 #ifndef RANDOM_WAL_MODEL_H
 #define RANDOM_WAL_MODEL_H
 
+#include <cmath>
 #include <iostream>
+#include <string>
 #include <vector>
-#include "Individual.h"
+#include "Arena.h"
+#include "Checkpoint.h"
+#include "GridStorage.h"
+#include "PopulationGrid.h"
+#include "NeighbourStencil.h"
+#include "TransitionPolicies.h"
+#include "TransitionTable.h"
 #include "State.h"
+#include "UpdateEngine.h"
 #include "RandomNumberGenerator.h"
 #include "ImageGenerator.h"
+#include "Profiler.h"
+#include "FrameExporter.h"
+#include "TilePyramidWriter.h"
+#include "Timestamp.h"
 
 using namespace std;
 
 /**
  * The RandomWalkModel handle the simulation steps.
+ * The Transitions policy decides whether the transition probabilities are given at run time
+ * (RandomWalkModel) or fixed at compile time (StaticRandomWalkModel).
  */
-class RandomWalkModel {
+template <typename Transitions>
+class BasicRandomWalkModel {
 
     protected:
 
+        /**
+         * Healthy individuals counted by number of isolated neighbours, gathered by one worker
+         * during a generation. Padded to a cache line so workers never write to a shared one.
+         */
+        struct alignas(64) IsolatedContacts {
+            uint64_t histogram[9] = {};
+        };
+
+        /**
+         * Individuals that entered (positive) or left (negative) each state, gathered by one
+         * worker during a generation. Padded to a cache line like IsolatedContacts.
+         */
+        struct alignas(64) StateChanges {
+            int64_t counts[TransitionTable::STATE_COUNT] = {};
+        };
+
         /**
          * Random number generator machine.
          */
-        RandomNumberGenerator* randomNumberGenerator;
+        RandomNumberGenerator randomNumberGenerator;
+
+        /**
+         * Index of the current run, part of the random stream key.
+         */
+        uint64_t run = 0;
+
+        /**
+         * Generations simulated so far in the current run, part of the random stream key.
+         */
+        uint64_t generation = 0;
+
+        /**
+         * Random stream key of the generation being computed.
+         */
+        uint64_t generationKey = 0;
+
+        /**
+         * Memory of the grids and of every worker and run buffer of the model.
+         * Declared before them, so it outlives them.
+         */
+        Arena arena;
+
+        /**
+         * Arena position past the buffers kept for the whole life of the model, the buffers of a run are allocated after it.
+         */
+        Arena::Marker runMarker;
 
         /**
          * The population grid stores the individuals based on matrix size param.
          */
-        vector<vector<Individual>> population;
+        PopulationGrid population;
 
         /**
-         * Pre load population to next run.
+         * Back buffer receiving the next generation, swapped with the population at the end of each one.
          */
-        vector<vector<Individual>> nextPopulation;
+        PopulationGrid nextPopulation;
 
         /**
-         * States change probabilities, ideally the sum of each line should result in 1.
+         * Memory layout of both population grids.
          */
-        vector<vector<double>> transitionProbabilities;
+        GridStorage storage;
+
+        /**
+         * States change probabilities as cumulative thresholds, ideally the sum of each line should result in 1.
+         * Also holds the infection thresholds of the current generation.
+         */
+        TransitionTable transitionTable;
 
         /**
          * The disease contagion factor.
@@ -43,6 +107,74 @@ class RandomWalkModel {
          */
         double contagionFactor;
 
+        /**
+         * The contagion factor the runs start with, before any social distancing reduction.
+         */
+        double initialContagionFactor;
+
+        /**
+         * Social distancing observations of each worker for the current generation.
+         */
+        ArenaVector<IsolatedContacts> isolatedContacts;
+
+        /**
+         * State changes of each worker for the current generation.
+         */
+        ArenaVector<StateChanges> stateChanges;
+
+        /**
+         * Individuals in each state, kept up to date at the end of each generation.
+         */
+        int64_t stateCounts[TransitionTable::STATE_COUNT] = {};
+
+        /**
+         * Determines if the state counts of every generation are kept.
+         */
+        bool recordStateHistory = false;
+
+        /**
+         * State counts of every generation of the last simulation, state major.
+         */
+        vector<uint32_t> stateHistory;
+
+        /**
+         * Generations stored so far in each state row of the state history.
+         */
+        size_t stateHistorySamples = 0;
+
+        /**
+         * Receives the population of the exported generations, if any.
+         */
+        FrameExporter* frameExporter = nullptr;
+
+        /**
+         * Checkpoint written every checkpointInterval generations, none when the interval is 0.
+         */
+        string checkpointFilename;
+
+        int checkpointInterval = 0;
+
+        /**
+         * Runs of the whole simulation, recorded in the checkpoints.
+         */
+        uint32_t checkpointRunCount = 0;
+
+        /**
+         * Generation the current simulation ends at.
+         */
+        uint64_t lastGeneration = 0;
+
+        /**
+         * Packed neighbour counts of the row segment being updated by each worker.
+         */
+        ArenaVector<ArenaVector<uint8_t>> neighbourCountRows;
+
+        /**
+         * Packed storage: the three rows read and the row written by each worker, one byte per individual.
+         * Unused with byte storage, whose rows are accessed in place.
+         */
+        ArenaVector<ArenaVector<uint8_t>> unpackedRows;
+
         /**
          * The population grid size.
          */
@@ -53,15 +185,37 @@ class RandomWalkModel {
          */
         bool applySocialDistanceEffect;
 
+        /**
+         * Strategy used to visit the individuals of each generation.
+         */
+        UpdateEngine engine = UpdateEngine::dense;
+
+        /**
+         * Sparse engine: individuals that are neither healthy nor dead, in grid index order.
+         */
+        ArenaVector<size_t> activeCells;
+
+        /**
+         * Sparse engine: individuals updated by the current generation.
+         */
+        ArenaVector<size_t> candidateCells;
+
+        /**
+         * Sparse engine: individuals updated by the previous generation.
+         */
+        ArenaVector<size_t> previousCandidateCells;
+
+        /**
+         * Sparse engine: flags the individuals already present in candidateCells.
+         */
+        ArenaVector<uint8_t> candidateMarks;
+
         /**
          * Fill the population vectors.
          */
         void initializePopulation()
         {
-            this->population.resize(
-                this->populationMatrixSize,
-                vector<Individual>(this->populationMatrixSize, Individual(State::healthy))
-            );
+            this->population = PopulationGrid(this->populationMatrixSize, State::healthy, this->storage, &this->arena);
             this->nextPopulation = this->population;
         }
 
@@ -71,109 +225,450 @@ class RandomWalkModel {
         void initializeSickIndividuals()
         {
             int startIndex = populationMatrixSize / 2;
-            this->population[startIndex][startIndex].state = State::sick;
-            this->nextPopulation[startIndex][startIndex].state = State::sick;
+            this->population.set(startIndex, startIndex, State::sick);
+            this->nextPopulation.set(startIndex, startIndex, State::sick);
         }
 
         /**
-         * Uses a randomic rate to calculate the social interactions.
+         * Record the social interactions of a healthy individual with its isolated neighbours.
+         * The neighbourhood is summarized by the packed counts of the NeighbourStencil, the
+         * contact with sick neighbours is resolved by the TransitionKernel.
          */
-        void computeSocialInteractions(int line, int column)
+        void computeSocialInteractions(uint8_t neighbourCounts, int worker)
         {
-            int initialLine = max(0, line - 1);
-            int finalLine = min(line + 2, this->populationMatrixSize);
+            int isolatedCount = NeighbourStencil::getIsolatedCount(neighbourCounts);
 
-            int isolatedCount = 0;
+            if (isolatedCount > 0 && this->applySocialDistanceEffect) {
+                this->isolatedContacts[worker].histogram[isolatedCount]++;
+            }
+        }
 
-            for (int i = initialLine; i < finalLine; ++i) {
-                int initialColumn = max(0, column - 1);
-                int finalColumn = min(column + 2, this->populationMatrixSize);
+        /**
+         * Apply the social distancing observed during the generation to the contagion factor.
+         * The factor stays constant while a generation is computed: each healthy individual with
+         * isolated neighbours reduces it by 5% per neighbour from the next generation on.
+         * The counts are integers summed across workers, so the result does not depend on
+         * the threads count or on the order the individuals were visited.
+         */
+        void applySocialDistanceEffectReduction()
+        {
+            for (int isolatedCount = 1; isolatedCount < 9; ++isolatedCount) {
+                uint64_t individuals = 0;
+                for (auto& contacts : this->isolatedContacts) {
+                    individuals += contacts.histogram[isolatedCount];
+                    contacts.histogram[isolatedCount] = 0;
+                }
+                if (individuals > 0) {
+                    double reduction = 0.05 * isolatedCount;
+                    this->contagionFactor = max(this->contagionFactor * pow(1.0 - reduction, static_cast<double>(individuals)), 0.1);
+                }
+            }
+        }
 
-                for (int j = initialColumn; j < finalColumn; ++j) {
-                    Individual& neighbour = population[i][j];
+        /**
+         * Allocate the social distancing tally, neighbour counts row and unpacked rows of each worker.
+         * They are kept for the life of the model, the run buffers come after them in the arena.
+         */
+        void setWorkerCount(int workerCount)
+        {
+            ArenaAllocator<uint8_t> allocator(&this->arena);
+            this->isolatedContacts = ArenaVector<IsolatedContacts>(workerCount, IsolatedContacts(), allocator);
+            this->stateChanges = ArenaVector<StateChanges>(workerCount, StateChanges(), allocator);
+            this->neighbourCountRows = ArenaVector<ArenaVector<uint8_t>>(allocator);
+            this->unpackedRows = ArenaVector<ArenaVector<uint8_t>>(allocator);
+            this->neighbourCountRows.reserve(workerCount);
+            this->unpackedRows.reserve(workerCount);
+            for (int worker = 0; worker < workerCount; ++worker) {
+                this->neighbourCountRows.emplace_back(this->populationMatrixSize, 0, allocator);
+                this->unpackedRows.emplace_back(4 * this->getUnpackedRowSize(), 0, allocator);
+            }
+            this->runMarker = this->arena.mark();
+            this->releaseRunBuffers();
+        }
 
-                    if (neighbour.state == State::isolated && this->applySocialDistanceEffect) {
-                        isolatedCount++;
-                    }
+        /**
+         * Release the sparse engine buffers of the run at once. The arena keeps their pages,
+         * already faulted in, for the buffers of the next run.
+         */
+        void releaseRunBuffers()
+        {
+            ArenaAllocator<uint8_t> allocator(&this->arena);
+            this->activeCells = ArenaVector<size_t>(allocator);
+            this->candidateCells = ArenaVector<size_t>(allocator);
+            this->previousCandidateCells = ArenaVector<size_t>(allocator);
+            this->candidateMarks = ArenaVector<uint8_t>(allocator);
+            this->arena.rewind(this->runMarker);
+        }
 
-                    if (neighbour.state == State::sick) {
-                        computeSickContact(nextPopulation[line][column], neighbour);
-                    }
-                }
+        /**
+         * Packed storage: bytes of an unpacked row, halo included.
+         */
+        size_t getUnpackedRowSize() const
+        {
+            return static_cast<size_t>(this->populationMatrixSize) + 2;
+        }
+
+        /**
+         * Handle the individual state transition.
+         * The back buffer holds a stale generation, so every individual writes its next state,
+         * including the ones that keep the current one.
+         */
+        void individualTransition(int line, int column, uint8_t neighbourCounts, int worker)
+        {
+            uint8_t individual = static_cast<uint8_t>(this->population.get(line, column));
+
+            if (individual == static_cast<uint8_t>(State::healthy)) {
+                this->computeSocialInteractions(neighbourCounts, worker);
             }
 
-            if (isolatedCount > 0 && this->applySocialDistanceEffect) {
-                double reduction = 0.05 * isolatedCount;
-                this->contagionFactor = max(this->contagionFactor * (1.0 - reduction), 0.1);
+            uint32_t bits = RandomNumberGenerator::getRandomBits(this->generationKey, line, column);
+            uint8_t nextIndividual = Transitions::transitionCell(this->transitionTable, individual, neighbourCounts, bits);
+            this->nextPopulation.set(line, column, static_cast<State>(nextIndividual));
+            if (nextIndividual != individual) {
+                this->stateChanges[worker].counts[individual]--;
+                this->stateChanges[worker].counts[nextIndividual]++;
             }
         }
 
         /**
-         * Handle the probability of an individual turns sick.
+         * Derive the random stream key and the infection thresholds of the generation about to be computed.
          */
-        void computeSickContact(Individual& individual, Individual& neighbour)
+        void beginGeneration()
         {
-            if (individual.state == State::dead) return;
+            this->generationKey = this->randomNumberGenerator.getGenerationKey(this->run, this->generation);
+            this->transitionTable.setContagionFactor(this->contagionFactor);
+        }
+
+        /**
+         * Transition of the columns [startColumn, endColumn) of a line.
+         */
+        void rowTransition(int line, int startColumn, int endColumn, int worker)
+        {
+            uint8_t* scratch = this->unpackedRows[worker].data();
+            const size_t scratchRow = this->getUnpackedRowSize();
+            const uint8_t* above = this->population.readRow(line - 1, startColumn, endColumn, scratch);
+            const uint8_t* individuals = this->population.readRow(line, startColumn, endColumn, scratch + scratchRow);
+            const uint8_t* below = this->population.readRow(line + 1, startColumn, endColumn, scratch + 2 * scratchRow);
+            uint8_t* nextIndividuals = this->nextPopulation.writeRow(line, startColumn, scratch + 3 * scratchRow);
+            uint8_t* neighbourCounts = this->neighbourCountRows[worker].data();
+            int count = endColumn - startColumn;
+
+            NeighbourStencil::countRow(above, individuals, below, count, neighbourCounts);
+            if (this->applySocialDistanceEffect) {
+                for (int j = 0; j < count; ++j) {
+                    if (individuals[j] == static_cast<uint8_t>(State::healthy)) {
+                        this->computeSocialInteractions(neighbourCounts[j], worker);
+                    }
+                }
+            }
 
-            double number = this->randomNumberGenerator->getRandomNumber();
+            Transitions::transitionRow(this->transitionTable, individuals, neighbourCounts,
+                                            nextIndividuals, count,
+                                            this->generationKey, line, startColumn);
+            this->recordStateChanges(individuals, nextIndividuals, count, worker);
+            this->nextPopulation.commitRow(line, startColumn, endColumn, nextIndividuals);
+        }
 
-            if (number < this->contagionFactor) {
-                individual.state = State::sick;
+        /**
+         * Tally the individuals of a row segment whose state changed.
+         */
+        void recordStateChanges(const uint8_t* individuals, const uint8_t* nextIndividuals, int count, int worker)
+        {
+            int64_t* changes = this->stateChanges[worker].counts;
+            for (int j = 0; j < count; ++j) {
+                if (individuals[j] != nextIndividuals[j]) {
+                    changes[individuals[j]]--;
+                    changes[nextIndividuals[j]]++;
+                }
             }
         }
 
         /**
-         * Handle the individual state transition.
+         * Add the state changes of every worker to the state counts.
          */
-        void individualTransition(int line, int column)
+        void applyStateChanges()
         {
-            Individual& individual = population[line][column];
+            for (auto& changes : this->stateChanges) {
+                for (int state = 0; state < TransitionTable::STATE_COUNT; ++state) {
+                    this->stateCounts[state] += changes.counts[state];
+                    changes.counts[state] = 0;
+                }
+            }
+        }
 
-            if (individual.state == State::dead) {
-                return;
+        /**
+         * Count the individuals in each state with a full scan of the population.
+         */
+        void initializeStateCounts()
+        {
+            uint8_t* scratch = this->unpackedRows[0].data();
+            fill(begin(this->stateCounts), end(this->stateCounts), 0);
+            for (int i = 0; i < this->populationMatrixSize; ++i) {
+                const uint8_t* row = this->population.readRow(i, 0, this->populationMatrixSize, scratch);
+                for (int j = 0; j < this->populationMatrixSize; ++j) {
+                    this->stateCounts[row[j]]++;
+                }
             }
+        }
 
-            if (individual.state == State::healthy) {
-                this->computeSocialInteractions(line, column);
-            } else {
-                const vector<double>& probabilities = this->transitionProbabilities[static_cast<int>(individual.state)];
-                double number = this->randomNumberGenerator->getRandomNumber();
+        /**
+         * Size the state history for a simulation and store the starting counts and frame.
+         * With checkpoints, the start of the run is saved too: the results of the previous runs
+         * are written by then, so a resumed simulation neither loses nor repeats any.
+         */
+        void beginSimulation(int generations)
+        {
+            this->lastGeneration = this->generation + generations;
+            if (this->checkpointInterval > 0 && generations > 0) {
+                PROFILE_SCOPE(checkpoint);
+                this->saveCheckpoint(this->checkpointFilename);
+            }
+            if (this->frameExporter != nullptr) {
+                this->frameExporter->capture(this->generation, this->population);
+            }
+            this->stateHistory.clear();
+            this->stateHistorySamples = 0;
+            if (this->recordStateHistory) {
+                this->stateHistory.resize(static_cast<size_t>(TransitionTable::STATE_COUNT) * (generations + 1));
+                this->appendStateHistory();
+            }
+        }
 
-                double cumulativeProbability = 0.0;
-                for (size_t i = 0; i < probabilities.size(); ++i) {
-                    cumulativeProbability += probabilities[i];
-                    if (number <= cumulativeProbability) {
-                        this->nextPopulation[line][column].state = static_cast<State>(i);
-                        break;
-                    }
+        /**
+         * Store the current state counts as the next generation of the state history.
+         */
+        void appendStateHistory()
+        {
+            const size_t length = this->stateHistory.size() / TransitionTable::STATE_COUNT;
+            for (int state = 0; state < TransitionTable::STATE_COUNT; ++state) {
+                this->stateHistory[state * length + this->stateHistorySamples] = static_cast<uint32_t>(this->stateCounts[state]);
+            }
+            this->stateHistorySamples++;
+        }
+
+        /**
+         * Swap the population grids and move to the next generation.
+         */
+        void endGeneration()
+        {
+            {
+                PROFILE_SCOPE(counting);
+                if (this->applySocialDistanceEffect) {
+                    this->applySocialDistanceEffectReduction();
                 }
+                this->applyStateChanges();
+                if (this->recordStateHistory) {
+                    this->appendStateHistory();
+                }
+            }
+            {
+                PROFILE_SCOPE(swap);
+                this->population.swap(this->nextPopulation);
+                this->generation++;
+            }
+            if (this->frameExporter != nullptr) {
+                PROFILE_SCOPE(image);
+                this->frameExporter->capture(this->generation, this->population);
+            }
+            //The last generation is not saved, the result of the run is written right after it.
+            if (this->checkpointInterval > 0 && this->generation % this->checkpointInterval == 0 && this->generation < this->lastGeneration) {
+                PROFILE_SCOPE(checkpoint);
+                this->saveCheckpoint(this->checkpointFilename);
             }
         }
 
         /**
-         * Make the individual transition for each individual and replace the population grids.
+         * Make the individual transition for each individual and swap the population grids.
          */
         void nextGeneration()
         {
+            {
+                PROFILE_SCOPE(update);
+                this->beginGeneration();
+                for (int i = 0; i < this->populationMatrixSize; ++i) {
+                    this->rowTransition(i, 0, this->populationMatrixSize, 0);
+                }
+                PROFILE_CELLS(static_cast<uint64_t>(this->populationMatrixSize) * this->populationMatrixSize);
+            }
+            this->endGeneration();
+        }
+
+        /**
+         * Sparse engine: find the active individuals and synchronize the back buffer.
+         * Called once at the start of a simulation.
+         */
+        void initializeActiveCells()
+        {
+            const size_t cellCount = static_cast<size_t>(this->populationMatrixSize) * this->populationMatrixSize;
+            this->activeCells.clear();
+            this->previousCandidateCells.clear();
+            this->candidateMarks.resize(cellCount);
+            fill(this->candidateMarks.begin(), this->candidateMarks.end(), 0);
             for (int i = 0; i < this->populationMatrixSize; ++i) {
                 for (int j = 0; j < this->populationMatrixSize; ++j) {
-                    this->individualTransition(i, j);
+                    State individual = this->population.get(i, j);
+                    this->nextPopulation.set(i, j, individual);
+                    if (individual != State::healthy && individual != State::dead) {
+                        this->activeCells.push_back(static_cast<size_t>(i) * this->populationMatrixSize + j);
+                    }
+                }
+            }
+        }
+
+        void addCandidateCell(size_t cell)
+        {
+            if (!this->candidateMarks[cell]) {
+                this->candidateMarks[cell] = 1;
+                this->candidateCells.push_back(cell);
+            }
+        }
+
+        /**
+         * Sparse engine: the active individuals plus every healthy neighbour that may change,
+         * that is, next to a sick individual, or to an isolated one when the lockdown effect is active.
+         * Any other healthy individual draws no random number and keeps its state.
+         */
+        void collectCandidateCells()
+        {
+            this->candidateCells.clear();
+            for (size_t cell : this->activeCells) {
+                this->addCandidateCell(cell);
+
+                int line = static_cast<int>(cell / this->populationMatrixSize);
+                int column = static_cast<int>(cell % this->populationMatrixSize);
+                State individual = this->population.get(line, column);
+                if (individual != State::sick && !(individual == State::isolated && this->applySocialDistanceEffect)) {
+                    continue;
+                }
+
+                for (int i = max(0, line - 1); i < min(line + 2, this->populationMatrixSize); ++i) {
+                    for (int j = max(0, column - 1); j < min(column + 2, this->populationMatrixSize); ++j) {
+                        if (this->population.get(i, j) == State::healthy) {
+                            this->addCandidateCell(static_cast<size_t>(i) * this->populationMatrixSize + j);
+                        }
+                    }
+                }
+            }
+        }
+
+        /**
+         * Sparse engine: transition of a slice of the candidates, or only of those on columns of
+         * the given parity when it is 0 or 1.
+         */
+        void updateCandidateCells(size_t begin, size_t end, int worker, int columnParity = -1)
+        {
+            for (size_t k = begin; k < end; ++k) {
+                size_t cell = this->candidateCells[k];
+                int line = static_cast<int>(cell / this->populationMatrixSize);
+                int column = static_cast<int>(cell % this->populationMatrixSize);
+                if (columnParity >= 0 && (column & 1) != columnParity) {
+                    continue;
+                }
+                this->individualTransition(line, column, NeighbourStencil::countCell(this->population, line, column), worker);
+            }
+        }
+
+        /**
+         * Sparse engine: carry forward the individuals updated last generation but not in this one,
+         * whose back buffer cell is stale, then keep the new active individuals.
+         */
+        void finishSparseGeneration()
+        {
+            for (size_t cell : this->previousCandidateCells) {
+                if (!this->candidateMarks[cell]) {
+                    int line = static_cast<int>(cell / this->populationMatrixSize);
+                    int column = static_cast<int>(cell % this->populationMatrixSize);
+                    this->nextPopulation.set(line, column, this->population.get(line, column));
+                }
+            }
+
+            this->activeCells.clear();
+            for (size_t cell : this->candidateCells) {
+                this->candidateMarks[cell] = 0;
+                State individual = this->nextPopulation.get(
+                    static_cast<int>(cell / this->populationMatrixSize),
+                    static_cast<int>(cell % this->populationMatrixSize)
+                );
+                if (individual != State::healthy && individual != State::dead) {
+                    this->activeCells.push_back(cell);
                 }
             }
-            this->population = this->nextPopulation;
+            this->previousCandidateCells.swap(this->candidateCells);
+        }
+
+        /**
+         * Make the individual transition for the active frontier only and swap the population grids.
+         */
+        void nextSparseGeneration()
+        {
+            {
+                PROFILE_SCOPE(update);
+                this->beginGeneration();
+                this->collectCandidateCells();
+                this->updateCandidateCells(0, this->candidateCells.size(), 0);
+                PROFILE_CELLS(this->candidateCells.size());
+                this->finishSparseGeneration();
+            }
+            this->endGeneration();
         }
 
     public:
 
         /**
          * Constructor.
+         * Packed storage halves the grids memory, at the cost of unpacking each row segment it updates.
          */
-        RandomWalkModel(int size, double contagionFactor, bool socialDistanceEffect)
-            : populationMatrixSize(size), contagionFactor(contagionFactor), applySocialDistanceEffect(socialDistanceEffect)
+        BasicRandomWalkModel(int size, double contagionFactor, bool socialDistanceEffect, GridStorage storage = GridStorage::bytes)
+            : arena(2 * PopulationGrid::memorySizeOf(size, storage) + Arena::HUGE_PAGE_SIZE),
+              storage(storage), contagionFactor(contagionFactor), initialContagionFactor(contagionFactor), populationMatrixSize(size), applySocialDistanceEffect(socialDistanceEffect)
         {
-            this->randomNumberGenerator = new RandomNumberGenerator();    
+            PROFILE_SCOPE(construction);
+            Transitions::initialize(this->transitionTable);
             this->initializePopulation();
+            this->setWorkerCount(1);
+            this->initializeSickIndividuals();
+            this->initializeStateCounts();
+        }
+
+        /**
+         * Start a new run in place: both grids are refilled without being reallocated, the
+         * individual in the middle is sick again and the contagion factor is back to its
+         * initial value. The buffers of the previous run are released in bulk. The random
+         * stream of the run is selected with setRandomStream, the other settings are kept.
+         */
+        void reset()
+        {
+            PROFILE_SCOPE(construction);
+            this->releaseRunBuffers();
+            this->population.fill(State::healthy);
+            this->nextPopulation.fill(State::healthy);
             this->initializeSickIndividuals();
+            this->contagionFactor = this->initialContagionFactor;
+            this->generation = 0;
+            fill(this->isolatedContacts.begin(), this->isolatedContacts.end(), IsolatedContacts());
+            fill(this->stateChanges.begin(), this->stateChanges.end(), StateChanges());
+            fill(begin(this->stateCounts), end(this->stateCounts), 0);
+            this->stateCounts[static_cast<int>(State::healthy)] = static_cast<int64_t>(this->populationMatrixSize) * this->populationMatrixSize - 1;
+            this->stateCounts[static_cast<int>(State::sick)] = 1;
+        }
+
+        /**
+         * Select the random stream of a run.
+         * The same seed and run index always produce the same results, whatever the threads count.
+         */
+        void setRandomStream(uint64_t seed, uint64_t run)
+        {
+            this->randomNumberGenerator = RandomNumberGenerator(seed);
+            this->run = run;
+        }
+
+        /**
+         * Select how the individuals of each generation are visited.
+         * Both engines give the same results for the same random stream.
+         */
+        void setUpdateEngine(UpdateEngine engine)
+        {
+            this->engine = engine;
         }
 
         /**
@@ -181,34 +676,117 @@ class RandomWalkModel {
          */
         void setTransitionProbabilities(vector<vector<double>> transitionProbabilities)
         {
-            this->transitionProbabilities = transitionProbabilities;
+            if (!Transitions::IS_DYNAMIC) {
+                throw logic_error("ERROR: The transition probabilities of this model are fixed at compile time.");
+            }
+            this->transitionTable.setTransitionProbabilities(transitionProbabilities);
         }
 
         /**
-         * Get the individuals count based on given state.
+         * Get the individuals count based on given state, as of the last generation computed.
          */
-        int getStateCount(State state)
+        int64_t getStateCount(State state) const
         {
-            int cumulated = 0;
-            for (const auto& row : this->population) {
-                for (const auto& individual : row) {
-                    if (individual.state == state) {
-                        cumulated++;
-                    }
-                }
+            int index = static_cast<int>(state);
+            if (index < 0 || index >= TransitionTable::STATE_COUNT) {
+                throw out_of_range("ERROR: Invalid state: " + to_string(index) + ".");
             }
-            return cumulated;
+            return this->stateCounts[index];
+        }
+
+        /**
+         * Keep the state counts of every generation of the next simulations.
+         */
+        void setStateHistory(bool recordStateHistory)
+        {
+            this->recordStateHistory = recordStateHistory;
+        }
+
+        /**
+         * State counts of every generation of the last simulation, from generation 0: one row
+         * of generations + 1 counts per state, in State order.
+         */
+        const vector<uint32_t>& getStateHistory() const
+        {
+            return this->stateHistory;
+        }
+
+        /**
+         * Export the population every few generations of the next simulations, nullptr to stop.
+         */
+        void setFrameExporter(FrameExporter* frameExporter)
+        {
+            this->frameExporter = frameExporter;
+        }
+
+        /**
+         * Image filename without extension, stamped with the current date.
+         */
+        static string getImageName()
+        {
+            return "Visual_Example_" + getTimestamp();
+        }
+
+        /**
+         * Write a checkpoint of the run every interval generations of the next simulations.
+         */
+        void setCheckpoint(const string& filename, int interval, uint32_t runCount)
+        {
+            this->checkpointFilename = filename;
+            this->checkpointInterval = interval;
+            this->checkpointRunCount = runCount;
+        }
+
+        /**
+         * Write the current generation of the run to a checkpoint.
+         */
+        void saveCheckpoint(const string& filename) const
+        {
+            Checkpoint::CheckpointHeader header;
+            header.seed = this->randomNumberGenerator.getSeed();
+            header.run = this->run;
+            header.generation = this->generation;
+            header.runCount = this->checkpointRunCount;
+            header.generationCount = static_cast<uint32_t>(this->lastGeneration);
+            header.contagionFactor = this->contagionFactor;
+            header.initialContagionFactor = this->initialContagionFactor;
+            header.socialDistanceEffect = this->applySocialDistanceEffect;
+            Checkpoint::write(filename, header, this->population);
+        }
+
+        /**
+         * Continue the run of a checkpoint: the next simulation starts from its generation,
+         * with the same results as if the run had not been interrupted.
+         * The model must have the population size and storage of the checkpoint.
+         */
+        Checkpoint::CheckpointHeader loadCheckpoint(const string& filename)
+        {
+            Checkpoint::CheckpointHeader header = Checkpoint::read(filename, this->population);
+            this->setRandomStream(header.seed, header.run);
+            this->generation = header.generation;
+            this->contagionFactor = header.contagionFactor;
+            this->applySocialDistanceEffect = header.socialDistanceEffect != 0;
+            this->initializeStateCounts();
+            return header;
         }
 
-        void generateImage()
+        /**
+         * Draw the population, one pixel per scale x scale block of individuals.
+         */
+        void generateImage(int scale = 1)
         {
-            const char* imageFilename = "Visual_Example_";
-            time_t currentTimestamp;
-            time(&currentTimestamp);
-            char buffer[20];
-            strftime(buffer, sizeof(buffer), "%Y%m%d_%H%M%S", localtime(&currentTimestamp));
-            string fullImageFilename = string(imageFilename) + buffer + ".png";
-            ImageGenerator::generate(fullImageFilename.c_str(), this->population);
+            PROFILE_SCOPE(image);
+            string fullImageFilename = getImageName() + ".png";
+            ImageGenerator::generate(fullImageFilename.c_str(), this->population, scale);
+        }
+
+        /**
+         * Draw the population as a Deep Zoom tile pyramid.
+         */
+        void generateImageTiles()
+        {
+            PROFILE_SCOPE(image);
+            TilePyramidWriter::write(getImageName(), this->population);
         }
 
         /**
@@ -216,6 +794,14 @@ class RandomWalkModel {
          */
         void simulation(int generations)
         {
+            this->beginSimulation(generations);
+            if (this->engine == UpdateEngine::sparse) {
+                this->initializeActiveCells();
+                for (int i = 0; i < generations; ++i) {
+                    this->nextSparseGeneration();
+                }
+                return;
+            }
             for (int i = 0; i < generations; ++i) {
                 this->nextGeneration();
             }
@@ -223,4 +809,15 @@ class RandomWalkModel {
 
 };
 
-#endif
\ No newline at end of file
+/**
+ * Model whose transition probabilities are given at run time.
+ */
+using RandomWalkModel = BasicRandomWalkModel<DynamicTransitions>;
+
+/**
+ * Model specialised for a transition matrix known at compile time.
+ */
+template <int NumStates, const TransitionMatrix<NumStates>& Matrix>
+using StaticRandomWalkModel = BasicRandomWalkModel<StaticTransitions<NumStates, Matrix>>;
+
+#endif
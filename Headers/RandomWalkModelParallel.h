@@ -1,83 +1,129 @@
 #ifndef RANDOM_WALK_MODEL_PARALLEL
 #define RANDOM_WALK_MODEL_PARALLEL
 
-#include <thread>
-#include <mutex>
+#include <atomic>
 #include <vector>
 #include <iostream>
 #include "RandomWalkModel.h"
-#include "MultithreadingController.h"
+#include "ThreadPool.h"
+#include "TileScheduler.h"
 
 using namespace std;
 
-class RandomWalkModelParallel : public RandomWalkModel {
+template <typename Transitions>
+class BasicRandomWalkModelParallel : public BasicRandomWalkModel<Transitions> {
     
     private:
     
         int threadCount;
 
-        int currentProcessorAvailableThreads;
+        /**
+         * Long-lived workers shared by every model instance.
+         */
+        ThreadPool* threadPool;
 
-        void processChunk(int startRow, int endRow) {
-            for (int i = startRow; i < endRow; ++i) {
-                for (int j = 0; j < this->populationMatrixSize; ++j) {
-                    this->individualTransition(i, j);
-                }
-            }
-        }
+        /**
+         * Deals the grid tiles to the workers, balancing the busy areas near the infection front.
+         */
+        TileScheduler tileScheduler;
 
-        void throwIfMaximumThreadsIsExceeded()
-        {
-            if(this->threadCount > this->currentProcessorAvailableThreads) {
-                throw out_of_range("ERROR: THE REQUESTED THREADS COUNT EXCEEDS THE CURRENT PROCESSOR AVAILABLE THREADS.");
-            }
-        }
-
-        void throwIfMultithreadingIsNotSupported()
-        {
-            if(this->threadCount == 0) {
-                throw out_of_range("ERROR: THE CURRENT PROCESSOR DOES NOT SUPPORTS MULTITHREADING, PLEASE REMOVE THE '-t' PARAM.");
+        void processTile(const TileScheduler::Tile& tile, int worker) {
+            for (int i = tile.startRow; i < tile.endRow; ++i) {
+                this->rowTransition(i, tile.startColumn, tile.endColumn, worker);
             }
         }
 
     public:
 
-        using RandomWalkModel::RandomWalkModel; // Inherit constructor.
+        using BasicRandomWalkModel<Transitions>::BasicRandomWalkModel; // Inherit constructor.
 
-        RandomWalkModelParallel(int populationMatrixSize, double contagionFactor, bool applySocialDistanceEffect, int threadCount):
-         RandomWalkModel(populationMatrixSize, contagionFactor, applySocialDistanceEffect), threadCount(threadCount)
+        /**
+         * Constructor, the workers are the ones of the pool. Its threads count is checked against
+         * the processor by the caller, see MultithreadingController::throwIfThreadCountIsNotSupported.
+         */
+        BasicRandomWalkModelParallel(int populationMatrixSize, double contagionFactor, bool applySocialDistanceEffect, ThreadPool& threadPool,
+         GridStorage storage = GridStorage::bytes):
+         BasicRandomWalkModel<Transitions>(populationMatrixSize, contagionFactor, applySocialDistanceEffect, storage), threadCount(threadPool.getThreadCount()), threadPool(&threadPool),
+         tileScheduler(populationMatrixSize, threadPool.getThreadCount())
         {
-            this->currentProcessorAvailableThreads = MultithreadingController::getCurrentProcessorAvailableThreads();
-            this->throwIfMultithreadingIsNotSupported();
-            this->throwIfMaximumThreadsIsExceeded();
+            this->setWorkerCount(this->threadCount);
         }
 
         void parallelSimulation(int generations) {
+            this->beginSimulation(generations);
+            if (this->engine == UpdateEngine::sparse) {
+                this->parallelSparseSimulation(generations);
+                return;
+            }
+
+            // Each worker processes tiles until none is left, stealing from the others when its own run out.
+            const function<void(int)> task = [this](int worker) {
+                int tileIndex;
+                while (this->tileScheduler.next(worker, tileIndex)) {
+                    processTile(this->tileScheduler.getTile(tileIndex), worker);
+                }
+            };
+
             for (int g = 0; g < generations; ++g) {
-                // Create threads to process chunks of the population grid.
-                vector<thread> threads;
-                int rowsPerThread = this->populationMatrixSize / this->threadCount;
-                int remainingRows = this->populationMatrixSize % this->threadCount;
-
-                for (int t = 0; t < this->threadCount; ++t) {
-                    int startRow = t * rowsPerThread;
-                    int endRow = startRow + rowsPerThread + (t < remainingRows ? 1 : 0);
-
-                    threads.emplace_back([this, startRow, endRow]() {
-                        processChunk(startRow, endRow);
-                    });
+                {
+                    PROFILE_SCOPE(update);
+                    this->beginGeneration();
+                    this->tileScheduler.reset();
+
+                    // Returns once every worker reached the barrier.
+                    this->threadPool->execute(task);
+                    PROFILE_CELLS(static_cast<uint64_t>(this->populationMatrixSize) * this->populationMatrixSize);
                 }
 
-                // Wait for all threads to finish.
-                for (auto& t : threads) {
-                    t.join();
+                // Swap population buffers.
+                this->endGeneration();
+            }
+        }
+
+        /**
+         * Sparse engine: the candidates are collected by the calling thread and updated by the workers in slices.
+         * With packed storage the two individuals of a byte are on an even and an odd column, the even
+         * columns are updated first and the odd ones after a barrier, so no two workers write the same byte.
+         */
+        void parallelSparseSimulation(int generations) {
+            const size_t sliceSize = 1024;
+            atomic<size_t> nextSlice(0);
+            int columnParity = -1;
+
+            const function<void(int)> task = [this, &nextSlice, &columnParity, sliceSize](int worker) {
+                size_t begin;
+                while ((begin = nextSlice.fetch_add(sliceSize, memory_order_relaxed)) < this->candidateCells.size()) {
+                    this->updateCandidateCells(begin, min(begin + sliceSize, this->candidateCells.size()), worker, columnParity);
                 }
+            };
 
-                // Swap population data.
-                this->population = this->nextPopulation;
+            this->initializeActiveCells();
+            for (int g = 0; g < generations; ++g) {
+                {
+                    PROFILE_SCOPE(update);
+                    this->beginGeneration();
+                    this->collectCandidateCells();
+                    if (this->population.isPacked()) {
+                        for (columnParity = 0; columnParity < 2; ++columnParity) {
+                            nextSlice.store(0, memory_order_relaxed);
+                            this->threadPool->execute(task);
+                        }
+                    } else {
+                        nextSlice.store(0, memory_order_relaxed);
+                        this->threadPool->execute(task);
+                    }
+                    PROFILE_CELLS(this->candidateCells.size());
+
+                    this->finishSparseGeneration();
+                }
+                this->endGeneration();
             }
         }
 };
 
+using RandomWalkModelParallel = BasicRandomWalkModelParallel<DynamicTransitions>;
+
+template <int NumStates, const TransitionMatrix<NumStates>& Matrix>
+using StaticRandomWalkModelParallel = BasicRandomWalkModelParallel<StaticTransitions<NumStates, Matrix>>;
 
-#endif
\ No newline at end of file
+#endif
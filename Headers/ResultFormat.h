@@ -0,0 +1,26 @@
+#ifndef RESULT_FORMAT_H
+#define RESULT_FORMAT_H
+
+/**
+ * Layout of the results printed for each run.
+ */
+enum class ResultFormat {
+
+    /**
+     * One count per line.
+     */
+    plain = 0,
+
+    /**
+     * A run,state,count header line, then one record per run.
+     */
+    csv = 1,
+
+    /**
+     * One JSON object per line.
+     */
+    jsonLines = 2
+
+};
+
+#endif
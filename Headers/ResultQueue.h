@@ -0,0 +1,101 @@
+#ifndef RESULT_QUEUE_H
+#define RESULT_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Bounded multi producer, multi consumer queue without locks (Dmitry Vyukov's design).
+ * Each slot carries a sequence number telling whether it is ready to be written or read
+ * for the current lap, so producers and consumers only contend on their own position.
+ * The capacity must be a power of two.
+ */
+template <typename T>
+class ResultQueue {
+
+    private:
+
+        struct Slot {
+            atomic<size_t> sequence;
+            T value;
+        };
+
+        vector<Slot> slots;
+
+        size_t mask;
+
+        /**
+         * Next position to write and to read, on their own cache lines.
+         */
+        alignas(64) atomic<size_t> enqueuePosition{0};
+
+        alignas(64) atomic<size_t> dequeuePosition{0};
+
+    public:
+
+        /**
+         * Constructor.
+         */
+        ResultQueue(size_t capacity = 4096)
+            : slots(capacity), mask(capacity - 1)
+        {
+            for (size_t i = 0; i < capacity; ++i) {
+                this->slots[i].sequence.store(i, memory_order_relaxed);
+            }
+        }
+
+        /**
+         * Returns false when the queue is full.
+         */
+        bool tryPush(const T& value)
+        {
+            size_t position = this->enqueuePosition.load(memory_order_relaxed);
+            while (true) {
+                Slot& slot = this->slots[position & this->mask];
+                size_t sequence = slot.sequence.load(memory_order_acquire);
+                intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+                if (difference == 0) {
+                    if (this->enqueuePosition.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                        slot.value = value;
+                        slot.sequence.store(position + 1, memory_order_release);
+                        return true;
+                    }
+                } else if (difference < 0) {
+                    return false;
+                } else {
+                    position = this->enqueuePosition.load(memory_order_relaxed);
+                }
+            }
+        }
+
+        /**
+         * Returns false when the queue is empty.
+         */
+        bool tryPop(T& value)
+        {
+            size_t position = this->dequeuePosition.load(memory_order_relaxed);
+            while (true) {
+                Slot& slot = this->slots[position & this->mask];
+                size_t sequence = slot.sequence.load(memory_order_acquire);
+                intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+                if (difference == 0) {
+                    if (this->dequeuePosition.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                        value = slot.value;
+                        slot.sequence.store(position + this->mask + 1, memory_order_release);
+                        return true;
+                    }
+                } else if (difference < 0) {
+                    return false;
+                } else {
+                    position = this->dequeuePosition.load(memory_order_relaxed);
+                }
+            }
+        }
+
+};
+
+#endif
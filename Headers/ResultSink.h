@@ -0,0 +1,202 @@
+#ifndef RESULT_SINK_H
+#define RESULT_SINK_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <thread>
+#include "BufferedWriter.h"
+#include "ResultFormat.h"
+#include "ResultQueue.h"
+#include "State.h"
+
+using namespace std;
+
+/**
+ * The result sink formats the result of each run and writes it to the standard output
+ * through a large buffer, flushed when full or when the sink is closed, instead of once per line.
+ */
+class ResultSink {
+
+    private:
+
+        BufferedWriter writer;
+
+        ResultFormat format;
+
+        /**
+         * The state whose individuals are counted.
+         */
+        State state;
+
+        static const char* getStateName(State state)
+        {
+            switch (state) {
+                case State::healthy: return "healthy";
+                case State::isolated: return "isolated";
+                case State::sick: return "sick";
+                case State::dead: return "dead";
+                case State::immune: return "immune";
+            }
+            return "unknown";
+        }
+
+    public:
+
+        /**
+         * Constructor, writes the CSV header if any.
+         */
+        ResultSink(ResultFormat format, State state, FILE* file = stdout)
+            : writer(file, "the standard output"), format(format), state(state)
+        {
+            if (this->format == ResultFormat::csv) {
+                this->writer.write(string("run,state,count\n"));
+            }
+        }
+
+        /**
+         * Write the result of a run.
+         */
+        void write(int run, int64_t count)
+        {
+            char line[128];
+            int length = 0;
+            switch (this->format) {
+                case ResultFormat::plain:
+                    length = snprintf(line, sizeof(line), "%lld\n", static_cast<long long>(count));
+                    break;
+                case ResultFormat::csv:
+                    length = snprintf(line, sizeof(line), "%d,%s,%lld\n", run, getStateName(this->state), static_cast<long long>(count));
+                    break;
+                case ResultFormat::jsonLines:
+                    length = snprintf(line, sizeof(line), "{\"run\":%d,\"state\":\"%s\",\"count\":%lld}\n",
+                                      run, getStateName(this->state), static_cast<long long>(count));
+                    break;
+            }
+            this->writer.write(line, length);
+        }
+
+        void flush()
+        {
+            this->writer.flush();
+        }
+
+};
+
+/**
+ * Feeds a result sink from several threads without blocking them: the results are pushed to
+ * a lock free queue, drained by a writer thread that puts them back in run order.
+ */
+class ConcurrentResultSink {
+
+    private:
+
+        struct Result {
+            int run;
+            int64_t count;
+        };
+
+        ResultSink& sink;
+
+        ResultQueue<Result> queue;
+
+        /**
+         * Results received ahead of the next run to write.
+         */
+        map<int, int64_t> pendingResults;
+
+        int nextRun = 0;
+
+        atomic<bool> closing{false};
+
+        thread writerThread;
+
+        void write(const Result& result)
+        {
+            if (result.run != this->nextRun) {
+                this->pendingResults.emplace(result.run, result.count);
+                return;
+            }
+            this->sink.write(result.run, result.count);
+            this->nextRun++;
+            for (auto pending = this->pendingResults.begin();
+                 pending != this->pendingResults.end() && pending->first == this->nextRun;
+                 pending = this->pendingResults.erase(pending)) {
+                this->sink.write(pending->first, pending->second);
+                this->nextRun++;
+            }
+        }
+
+        /**
+         * Drain the queue until the sink is closed, sleeping a little longer each time it is found empty.
+         */
+        void writerLoop()
+        {
+            const chrono::microseconds maximumWait(1000);
+            chrono::microseconds wait(1);
+            Result result;
+            while (true) {
+                bool closed = this->closing.load(memory_order_acquire);
+                if (this->queue.tryPop(result)) {
+                    this->write(result);
+                    wait = chrono::microseconds(1);
+                } else if (closed) {
+                    break;
+                } else {
+                    this_thread::sleep_for(wait);
+                    wait = min(wait * 2, maximumWait);
+                }
+            }
+        }
+
+    public:
+
+        /**
+         * Constructor, starts the writer thread.
+         */
+        ConcurrentResultSink(ResultSink& sink)
+            : sink(sink)
+        {
+            this->writerThread = thread([this]() {
+                this->writerLoop();
+            });
+        }
+
+        ~ConcurrentResultSink()
+        {
+            this->close();
+        }
+
+        ConcurrentResultSink(const ConcurrentResultSink&) = delete;
+
+        ConcurrentResultSink& operator=(const ConcurrentResultSink&) = delete;
+
+        /**
+         * Queue the result of a run, only waits if the writer thread is a whole queue behind.
+         */
+        void write(int run, int64_t count)
+        {
+            Result result = {run, count};
+            while (!this->queue.tryPush(result)) {
+                this_thread::yield();
+            }
+        }
+
+        /**
+         * Write the remaining results and stop the writer thread.
+         */
+        void close()
+        {
+            if (this->writerThread.joinable()) {
+                this->closing.store(true, memory_order_release);
+                this->writerThread.join();
+                this->sink.flush();
+            }
+        }
+
+};
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Profiler.h"
+
+using namespace std;
+
+/**
+ * The thread pool keeps its workers alive for the whole program, so a generation
+ * only costs a wake up and a barrier instead of creating and joining threads.
+ */
+class ThreadPool {
+
+    private:
+
+        /**
+         * Background workers, the calling thread acts as worker 0.
+         */
+        vector<thread> workers;
+
+        mutex lock;
+
+        condition_variable taskAvailable;
+
+        condition_variable taskFinished;
+
+        /**
+         * Task of the current epoch, called once by each worker with its index.
+         */
+        const function<void(int)>* task = nullptr;
+
+        /**
+         * Incremented each time a task is published.
+         */
+        uint64_t epoch = 0;
+
+        /**
+         * Workers that did not reach the barrier of the current epoch yet.
+         */
+        int pendingWorkers = 0;
+
+        bool stopping = false;
+
+        void workerLoop(int workerIndex)
+        {
+            uint64_t seenEpoch = 0;
+            while (true) {
+                const function<void(int)>* currentTask;
+                {
+                    unique_lock<mutex> guard(this->lock);
+                    this->taskAvailable.wait(guard, [this, seenEpoch]() {
+                        return this->stopping || this->epoch != seenEpoch;
+                    });
+                    if (this->stopping) {
+                        return;
+                    }
+                    seenEpoch = this->epoch;
+                    currentTask = this->task;
+                }
+
+                this->runTask(*currentTask, workerIndex);
+                this->arrive();
+            }
+        }
+
+        /**
+         * Run the task of a worker, recording its busy time when profiling.
+         */
+        static void runTask(const function<void(int)>& task, int workerIndex)
+        {
+#if PANDEMIC_SIM_PROFILING
+            if (Profiler::getInstance().isEnabled()) {
+                uint64_t start = Profiler::now();
+                task(workerIndex);
+                Profiler::getInstance().recordWorker(workerIndex, Profiler::now() - start);
+                return;
+            }
+#endif
+            task(workerIndex);
+        }
+
+        /**
+         * Barrier arrival, the last worker wakes up the caller.
+         */
+        void arrive()
+        {
+            lock_guard<mutex> guard(this->lock);
+            if (--this->pendingWorkers == 0) {
+                this->taskFinished.notify_one();
+            }
+        }
+
+    public:
+
+        /**
+         * Constructor.
+         */
+        ThreadPool(int threadCount)
+        {
+            for (int i = 1; i < threadCount; ++i) {
+                this->workers.emplace_back([this, i]() {
+                    this->workerLoop(i);
+                });
+            }
+        }
+
+        ~ThreadPool()
+        {
+            {
+                lock_guard<mutex> guard(this->lock);
+                this->stopping = true;
+            }
+            this->taskAvailable.notify_all();
+            for (auto& worker : this->workers) {
+                worker.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        int getThreadCount() const
+        {
+            return static_cast<int>(this->workers.size()) + 1;
+        }
+
+        /**
+         * Run the task on every worker, including the calling thread, and wait until all of them finish.
+         */
+        void execute(const function<void(int workerIndex)>& task)
+        {
+#if PANDEMIC_SIM_PROFILING
+            uint64_t start = Profiler::getInstance().isEnabled() ? Profiler::now() : 0;
+#endif
+            {
+                lock_guard<mutex> guard(this->lock);
+                this->task = &task;
+                this->pendingWorkers = this->getThreadCount();
+                this->epoch++;
+            }
+            this->taskAvailable.notify_all();
+
+            this->runTask(task, 0);
+
+            {
+                unique_lock<mutex> guard(this->lock);
+                this->pendingWorkers--;
+                this->taskFinished.wait(guard, [this]() {
+                    return this->pendingWorkers == 0;
+                });
+            }
+#if PANDEMIC_SIM_PROFILING
+            if (start != 0) {
+                Profiler::getInstance().recordPoolTask(this->getThreadCount(), Profiler::now() - start);
+            }
+#endif
+        }
+
+};
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef TILE_PYRAMID_WRITER_H
+#define TILE_PYRAMID_WRITER_H
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "ImageGenerator.h"
+#include "PopulationGrid.h"
+
+using namespace std;
+
+/**
+ * The tile pyramid writer draws the population as a Deep Zoom image (.dzi) that viewers
+ * such as OpenSeadragon load tile by tile: the full resolution level holds one pixel per
+ * individual, each level below halves both sides with the majority state of each 2x2 block,
+ * down to a single pixel, and every level is cut into square PNG tiles.
+ *
+ * The levels are built in a single streaming pass over the grid rows. Each level only keeps
+ * the band of rows of its current row of tiles, and hands its rows two by two to the level
+ * below, so the memory used is about two tile bands of the grid width.
+ */
+class TilePyramidWriter {
+
+    private:
+
+        struct Level {
+            int size;
+            vector<uint8_t> band;
+            int bandRows = 0;
+            int tileRow = 0;
+            vector<uint8_t> pendingRow;
+            bool hasPendingRow = false;
+        };
+
+        string filesDirectory;
+
+        int tileSize;
+
+        vector<Level> levels;
+
+        /**
+         * Level of a row, 0 being the single pixel one.
+         */
+        void pushRow(int level, const uint8_t* row)
+        {
+            Level& current = this->levels[level];
+            copy(row, row + current.size, current.band.begin() + static_cast<size_t>(current.bandRows) * current.size);
+            current.bandRows++;
+            if (current.bandRows == this->tileSize) {
+                this->writeBand(level);
+            }
+
+            if (level == 0) {
+                return;
+            }
+            if (!current.hasPendingRow) {
+                copy(row, row + current.size, current.pendingRow.begin());
+                current.hasPendingRow = true;
+                return;
+            }
+            this->pushDownsampledRow(level, current.pendingRow.data(), row);
+            current.hasPendingRow = false;
+        }
+
+        /**
+         * Hand the majority of each 2x2 block of two rows to the level below, the second row
+         * may be missing on the last row of a level of odd size.
+         */
+        void pushDownsampledRow(int level, const uint8_t* firstRow, const uint8_t* secondRow)
+        {
+            const int size = this->levels[level].size;
+            vector<uint8_t> downsampledRow(this->levels[level - 1].size);
+            for (int j = 0; j < static_cast<int>(downsampledRow.size()); ++j) {
+                uint32_t counts[ImageGenerator::PALETTE_SIZE] = {};
+                for (int k = 2 * j; k < min(2 * j + 2, size); ++k) {
+                    counts[firstRow[k]]++;
+                    if (secondRow != nullptr) {
+                        counts[secondRow[k]]++;
+                    }
+                }
+                downsampledRow[j] = ImageGenerator::getMajorityState(counts);
+            }
+            this->pushRow(level - 1, downsampledRow.data());
+        }
+
+        /**
+         * Write the tiles of the band of rows kept by a level.
+         */
+        void writeBand(int level)
+        {
+            Level& current = this->levels[level];
+            if (current.bandRows == 0) {
+                return;
+            }
+            string directory = this->filesDirectory + "/" + to_string(level);
+            filesystem::create_directories(directory);
+            for (int column = 0; column * this->tileSize < current.size; ++column) {
+                int width = min(this->tileSize, current.size - column * this->tileSize);
+                string filename = directory + "/" + to_string(column) + "_" + to_string(current.tileRow) + ".png";
+                if (!ImageGenerator::writePng(filename.c_str(), width, current.bandRows,
+                                              current.band.data() + column * this->tileSize, current.size)) {
+                    throw runtime_error("ERROR: Failed to save tile " + filename + ".");
+                }
+            }
+            current.bandRows = 0;
+            current.tileRow++;
+        }
+
+    public:
+
+        /**
+         * Write the pyramid of a population to name.dzi and its tiles to name_files.
+         */
+        static void write(const string& name, const PopulationGrid& population, int tileSize = 256)
+        {
+            TilePyramidWriter writer;
+            writer.filesDirectory = name + "_files";
+            writer.tileSize = tileSize;
+
+            const int size = population.getSize();
+            int levelCount = 1;
+            while ((1 << (levelCount - 1)) < size) {
+                levelCount++;
+            }
+            writer.levels.resize(levelCount);
+            for (int level = levelCount - 1, levelSize = size; level >= 0; --level, levelSize = (levelSize + 1) / 2) {
+                writer.levels[level].size = levelSize;
+                writer.levels[level].band.resize(static_cast<size_t>(levelSize) * tileSize);
+                writer.levels[level].pendingRow.resize(levelSize);
+            }
+
+            vector<uint8_t> row(size);
+            for (int i = 0; i < size; ++i) {
+                population.unpackRow(i, 0, size, row.data());
+                writer.pushRow(levelCount - 1, row.data());
+            }
+
+            // Flush the odd last rows and the partial bands, from the full resolution level down.
+            for (int level = levelCount - 1; level >= 0; --level) {
+                if (writer.levels[level].hasPendingRow) {
+                    writer.levels[level].hasPendingRow = false;
+                    writer.pushDownsampledRow(level, writer.levels[level].pendingRow.data(), nullptr);
+                }
+                writer.writeBand(level);
+            }
+
+            ofstream descriptor(name + ".dzi");
+            descriptor << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                       << "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" Format=\"png\" Overlap=\"0\" TileSize=\"" << tileSize << "\">\n"
+                       << "  <Size Width=\"" << size << "\" Height=\"" << size << "\"/>\n"
+                       << "</Image>\n";
+            if (!descriptor) {
+                throw runtime_error("ERROR: Failed to save " + name + ".dzi.");
+            }
+            cout << "\nImage tiles saved successfully as " << name << ".dzi" << endl;
+        }
+
+};
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+/**
+ * The tile scheduler splits the grid into square tiles and deals them to the workers.
+ * Each worker owns a contiguous range of tiles and takes them from the front, an idle
+ * worker steals from the back of the other ranges.
+ */
+class TileScheduler {
+
+    public:
+
+        /**
+         * Grid area covered by one tile, end bounds are exclusive.
+         */
+        struct Tile {
+            int startRow;
+            int endRow;
+            int startColumn;
+            int endColumn;
+        };
+
+    private:
+
+        /**
+         * Range of tile indices still owned by a worker, packed as (begin << 32 | end)
+         * so both ends are claimed with a single compare-and-swap.
+         * Padded to a cache line to keep workers from sharing it.
+         */
+        struct alignas(64) WorkerRange {
+            atomic<uint64_t> range{0};
+        };
+
+        int gridSize;
+
+        int tileSize;
+
+        int tilesPerSide;
+
+        vector<WorkerRange> ranges;
+
+        static uint64_t pack(uint32_t begin, uint32_t end)
+        {
+            return static_cast<uint64_t>(begin) << 32 | end;
+        }
+
+        /**
+         * Claim the first tile of a range, used by its owner.
+         */
+        bool popFront(int worker, int& tileIndex)
+        {
+            atomic<uint64_t>& range = this->ranges[worker].range;
+            uint64_t current = range.load(memory_order_relaxed);
+            while (true) {
+                uint32_t begin = static_cast<uint32_t>(current >> 32);
+                uint32_t end = static_cast<uint32_t>(current);
+                if (begin >= end) {
+                    return false;
+                }
+                if (range.compare_exchange_weak(current, pack(begin + 1, end), memory_order_relaxed)) {
+                    tileIndex = static_cast<int>(begin);
+                    return true;
+                }
+            }
+        }
+
+        /**
+         * Claim the last tile of a range, used by thieves.
+         */
+        bool popBack(int worker, int& tileIndex)
+        {
+            atomic<uint64_t>& range = this->ranges[worker].range;
+            uint64_t current = range.load(memory_order_relaxed);
+            while (true) {
+                uint32_t begin = static_cast<uint32_t>(current >> 32);
+                uint32_t end = static_cast<uint32_t>(current);
+                if (begin >= end) {
+                    return false;
+                }
+                if (range.compare_exchange_weak(current, pack(begin, end - 1), memory_order_relaxed)) {
+                    tileIndex = static_cast<int>(end - 1);
+                    return true;
+                }
+            }
+        }
+
+    public:
+
+        /**
+         * Constructor.
+         */
+        TileScheduler(int gridSize, int workerCount, int tileSize = 64)
+            : gridSize(gridSize), tileSize(max(1, tileSize)), ranges(max(1, workerCount))
+        {
+            this->tilesPerSide = (gridSize + this->tileSize - 1) / this->tileSize;
+        }
+
+        int getTileCount() const
+        {
+            return this->tilesPerSide * this->tilesPerSide;
+        }
+
+        Tile getTile(int tileIndex) const
+        {
+            int startRow = (tileIndex / this->tilesPerSide) * this->tileSize;
+            int startColumn = (tileIndex % this->tilesPerSide) * this->tileSize;
+            return {
+                startRow,
+                min(startRow + this->tileSize, this->gridSize),
+                startColumn,
+                min(startColumn + this->tileSize, this->gridSize)
+            };
+        }
+
+        /**
+         * Deal the tiles in contiguous ranges, must be called before the workers start.
+         */
+        void reset()
+        {
+            int workerCount = static_cast<int>(this->ranges.size());
+            int tileCount = this->getTileCount();
+            int tilesPerWorker = tileCount / workerCount;
+            int remainingTiles = tileCount % workerCount;
+            for (int w = 0; w < workerCount; ++w) {
+                uint32_t begin = w * tilesPerWorker + min(w, remainingTiles);
+                uint32_t end = begin + tilesPerWorker + (w < remainingTiles ? 1 : 0);
+                this->ranges[w].range.store(pack(begin, end), memory_order_relaxed);
+            }
+        }
+
+        /**
+         * Next tile for the worker, its own range first then the other ones.
+         * Returns false once every tile was claimed.
+         */
+        bool next(int worker, int& tileIndex)
+        {
+            if (this->popFront(worker, tileIndex)) {
+                return true;
+            }
+            int workerCount = static_cast<int>(this->ranges.size());
+            for (int offset = 1; offset < workerCount; ++offset) {
+                if (this->popBack((worker + offset) % workerCount, tileIndex)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef TIME_SERIES_WRITER_H
+#define TIME_SERIES_WRITER_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "BufferedWriter.h"
+#include "TransitionTable.h"
+
+using namespace std;
+
+/**
+ * The time series writer stores the individuals count of every state, at every generation
+ * of every run, in a columnar binary file:
+ * - a fixed size TimeSeriesHeader;
+ * - then, for each run in order, stateCount arrays of sampleCount uint32 values, one per
+ *   state in State order, each one holding the count from generation 0 to the last one.
+ * Every value is written in the byte order of the machine, the header magic tells it apart.
+ */
+class TimeSeriesWriter {
+
+    public:
+
+        struct TimeSeriesHeader {
+            char magic[4] = {'P', 'S', 'T', 'S'};
+            uint32_t version = 1;
+            uint32_t stateCount = TransitionTable::STATE_COUNT;
+            uint32_t runCount = 0;
+            uint32_t sampleCount = 0;
+            uint32_t populationMatrixSize = 0;
+            uint64_t seed = 0;
+            double contagionFactor = 0.0;
+            uint32_t socialDistanceEffect = 0;
+            uint32_t reserved = 0;
+        };
+
+        static_assert(sizeof(TimeSeriesHeader) == 48, "The time series header layout must not depend on the compiler.");
+
+    private:
+
+        BufferedWriter writer;
+
+        TimeSeriesHeader header;
+
+        /**
+         * Runs finished ahead of the next one to write, when runs are distributed across threads.
+         */
+        map<int, vector<uint32_t>> pendingRuns;
+
+        int nextRun = 0;
+
+        mutex lock;
+
+        void writeSeries(const uint32_t* series)
+        {
+            this->writer.write(series, this->getSeriesSize() * sizeof(uint32_t));
+        }
+
+    public:
+
+        /**
+         * Constructor, writes the header.
+         */
+        TimeSeriesWriter(const string& filename, int runCount, int generations, int populationMatrixSize,
+                         uint64_t seed, double contagionFactor, bool socialDistanceEffect)
+            : writer(filename)
+        {
+            if (static_cast<uint64_t>(populationMatrixSize) * populationMatrixSize > UINT32_MAX) {
+                throw out_of_range("ERROR: The population is too large for the time series uint32 counts.");
+            }
+            this->header.runCount = runCount;
+            this->header.sampleCount = generations + 1;
+            this->header.populationMatrixSize = populationMatrixSize;
+            this->header.seed = seed;
+            this->header.contagionFactor = contagionFactor;
+            this->header.socialDistanceEffect = socialDistanceEffect;
+            this->writer.write(&this->header, sizeof(this->header));
+        }
+
+        /**
+         * Values of one run, stateCount * sampleCount.
+         */
+        size_t getSeriesSize() const
+        {
+            return static_cast<size_t>(this->header.stateCount) * this->header.sampleCount;
+        }
+
+        /**
+         * Write the series of a run, state major. Runs may be given in any order and from any
+         * thread, they are written in run order.
+         */
+        void writeRun(int run, const vector<uint32_t>& series)
+        {
+            if (series.size() != this->getSeriesSize()) {
+                throw invalid_argument("ERROR: The time series of run " + to_string(run) + " has the wrong length.");
+            }
+            lock_guard<mutex> guard(this->lock);
+            if (run != this->nextRun) {
+                this->pendingRuns.emplace(run, series);
+                return;
+            }
+            this->writeSeries(series.data());
+            this->nextRun++;
+            for (auto pending = this->pendingRuns.begin();
+                 pending != this->pendingRuns.end() && pending->first == this->nextRun;
+                 pending = this->pendingRuns.erase(pending)) {
+                this->writeSeries(pending->second.data());
+                this->nextRun++;
+            }
+        }
+
+        /**
+         * Write the buffered runs to the file.
+         */
+        void flush()
+        {
+            lock_guard<mutex> guard(this->lock);
+            this->writer.flush();
+        }
+
+};
+
+#endif
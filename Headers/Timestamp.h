@@ -0,0 +1,21 @@
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include <ctime>
+#include <string>
+
+using namespace std;
+
+/**
+ * Current local date and time as YYYYMMDD_HHMMSS, stamped on the names of the generated files.
+ */
+inline string getTimestamp()
+{
+    time_t currentTimestamp;
+    time(&currentTimestamp);
+    char buffer[20];
+    strftime(buffer, sizeof(buffer), "%Y%m%d_%H%M%S", localtime(&currentTimestamp));
+    return buffer;
+}
+
+#endif
@@ -0,0 +1,279 @@
+#ifndef TRANSITION_KERNEL_H
+#define TRANSITION_KERNEL_H
+
+#include <cstdint>
+#include <cstring>
+#include "RandomNumberGenerator.h"
+#include "State.h"
+#include "TransitionTable.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define PANDEMIC_SIM_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+/**
+ * The transition kernel computes the next state of a row segment from its states, its packed
+ * neighbour counts and one random draw per individual. The AVX2 path handles 32 individuals
+ * per iteration and the SSE4.1 path 16, the scalar path handles the tails and any other CPU.
+ * Every path gives the same results.
+ *
+ * Each path is instantiated for the thresholds of the table given at run time, or with
+ * StaticTable pointing to a table built at compile time for the thresholds of that one:
+ * they are then constants, folded into the scalar comparisons and the SIMD broadcasts and
+ * lookups. The infection thresholds depend on the contagion factor and are always read from
+ * the run time table.
+ */
+class TransitionKernel {
+
+    public:
+
+        using RowKernel = void (*)(const TransitionTable&, const uint8_t*, const uint8_t*, uint8_t*, int,
+                                   uint64_t, uint32_t, uint32_t);
+
+        /**
+         * Table the transition thresholds are read from.
+         */
+        template <const TransitionTable* StaticTable>
+        static constexpr const TransitionTable& thresholdTable(const TransitionTable& table)
+        {
+            if constexpr (StaticTable != nullptr) {
+                return *StaticTable;
+            } else {
+                return table;
+            }
+        }
+
+        /**
+         * Next state of a single individual, the reference of every SIMD path.
+         */
+        template <const TransitionTable* StaticTable = nullptr>
+        static uint8_t transitionCell(const TransitionTable& table, uint8_t state, uint8_t neighbourCounts, uint32_t bits)
+        {
+            if (state == static_cast<uint8_t>(State::dead)) {
+                return state;
+            }
+            if (state == static_cast<uint8_t>(State::healthy)) {
+                return bits < table.infectionThresholds[neighbourCounts & 0x0F]
+                    ? static_cast<uint8_t>(State::sick)
+                    : state;
+            }
+            const TransitionTable& thresholds = thresholdTable<StaticTable>(table);
+            uint8_t target = 0;
+            for (int i = 0; i < TransitionTable::STATE_COUNT; ++i) {
+                target += bits > thresholds.thresholds[state][i];
+            }
+            return target == TransitionTable::STATE_COUNT ? state : target;
+        }
+
+        template <const TransitionTable* StaticTable = nullptr>
+        static void transitionRowScalar(const TransitionTable& table, const uint8_t* states, const uint8_t* neighbourCounts,
+                                        uint8_t* nextStates, int count, uint64_t generationKey, uint32_t line, uint32_t firstColumn)
+        {
+            for (int j = 0; j < count; ++j) {
+                uint32_t bits = RandomNumberGenerator::getRandomBits(generationKey, line, firstColumn + j);
+                nextStates[j] = transitionCell<StaticTable>(table, states[j], neighbourCounts[j], bits);
+            }
+        }
+
+#ifdef PANDEMIC_SIM_X86_KERNELS
+
+        __attribute__((target("avx2")))
+        static inline __m256i mix32Avx2(__m256i value)
+        {
+            value = _mm256_xor_si256(value, _mm256_srli_epi32(value, 16));
+            value = _mm256_mullo_epi32(value, _mm256_set1_epi32(static_cast<int>(0x85EBCA6Bu)));
+            value = _mm256_xor_si256(value, _mm256_srli_epi32(value, 13));
+            value = _mm256_mullo_epi32(value, _mm256_set1_epi32(static_cast<int>(0xC2B2AE35u)));
+            return _mm256_xor_si256(value, _mm256_srli_epi32(value, 16));
+        }
+
+        /**
+         * Eight individuals, one per 32 bits lane.
+         */
+        __attribute__((target("avx2")))
+        static inline __m256i transitionGroupAvx2(const uint8_t* states, const uint8_t* neighbourCounts, __m256i columns,
+                                                  __m256i keyLow, __m256i lineKey, const __m256i* thresholdColumns,
+                                                  __m256i infectionLow, __m256i infectionHigh)
+        {
+            const __m256i signBit = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+            __m256i state = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(states)));
+            __m256i counts = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(neighbourCounts)));
+
+            __m256i bits = mix32Avx2(_mm256_xor_si256(mix32Avx2(_mm256_xor_si256(keyLow, columns)), lineKey));
+            __m256i biasedBits = _mm256_xor_si256(bits, signBit);
+
+            // Unsigned bits > threshold for every target, the matches count is the next state.
+            __m256i target = _mm256_setzero_si256();
+            for (int i = 0; i < TransitionTable::STATE_COUNT; ++i) {
+                __m256i threshold = _mm256_xor_si256(_mm256_permutevar8x32_epi32(thresholdColumns[i], state), signBit);
+                target = _mm256_sub_epi32(target, _mm256_cmpgt_epi32(biasedBits, threshold));
+            }
+            target = _mm256_blendv_epi8(target, state,
+                                        _mm256_cmpeq_epi32(target, _mm256_set1_epi32(TransitionTable::STATE_COUNT)));
+
+            __m256i sickCount = _mm256_and_si256(counts, _mm256_set1_epi32(0x0F));
+            __m256i infection = _mm256_blendv_epi8(_mm256_permutevar8x32_epi32(infectionLow, sickCount),
+                                                   _mm256_permutevar8x32_epi32(infectionHigh, sickCount),
+                                                   _mm256_cmpgt_epi32(sickCount, _mm256_set1_epi32(7)));
+            __m256i infected = _mm256_cmpgt_epi32(_mm256_xor_si256(infection, signBit), biasedBits);
+            __m256i healthyTarget = _mm256_and_si256(infected, _mm256_set1_epi32(static_cast<int>(State::sick)));
+
+            __m256i dead = _mm256_set1_epi32(static_cast<int>(State::dead));
+            target = _mm256_blendv_epi8(target, healthyTarget, _mm256_cmpeq_epi32(state, _mm256_setzero_si256()));
+            return _mm256_blendv_epi8(target, dead, _mm256_cmpeq_epi32(state, dead));
+        }
+
+        template <const TransitionTable* StaticTable = nullptr>
+        __attribute__((target("avx2")))
+        static void transitionRowAvx2(const TransitionTable& table, const uint8_t* states, const uint8_t* neighbourCounts,
+                                      uint8_t* nextStates, int count, uint64_t generationKey, uint32_t line, uint32_t firstColumn)
+        {
+            const TransitionTable& thresholds = thresholdTable<StaticTable>(table);
+            __m256i thresholdColumns[TransitionTable::STATE_COUNT];
+            for (int i = 0; i < TransitionTable::STATE_COUNT; ++i) {
+                thresholdColumns[i] = _mm256_setr_epi32(
+                    static_cast<int>(thresholds.thresholds[0][i]), static_cast<int>(thresholds.thresholds[1][i]),
+                    static_cast<int>(thresholds.thresholds[2][i]), static_cast<int>(thresholds.thresholds[3][i]),
+                    static_cast<int>(thresholds.thresholds[4][i]), 0, 0, 0
+                );
+            }
+            __m256i infectionLow = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(table.infectionThresholds));
+            __m256i infectionHigh = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(table.infectionThresholds + 8));
+            __m256i keyLow = _mm256_set1_epi32(static_cast<int>(static_cast<uint32_t>(generationKey)));
+            __m256i lineKey = _mm256_set1_epi32(static_cast<int>(static_cast<uint32_t>(generationKey >> 32) ^ (line * 0x9E3779B9u)));
+            __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+            __m256i packOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+            int j = 0;
+            for (; j + 32 <= count; j += 32) {
+                __m256i groups[4];
+                for (int g = 0; g < 4; ++g) {
+                    __m256i columns = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(firstColumn + j + 8 * g)), laneOffsets);
+                    groups[g] = transitionGroupAvx2(states + j + 8 * g, neighbourCounts + j + 8 * g, columns, keyLow, lineKey,
+                                                    thresholdColumns, infectionLow, infectionHigh);
+                }
+                // The packs interleave the 128 bits lanes, the permutation restores the individuals order.
+                __m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(groups[0], groups[1]),
+                                                     _mm256_packus_epi32(groups[2], groups[3]));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(nextStates + j), _mm256_permutevar8x32_epi32(packed, packOrder));
+            }
+            transitionRowScalar<StaticTable>(table, states + j, neighbourCounts + j, nextStates + j, count - j, generationKey, line, firstColumn + j);
+        }
+
+        __attribute__((target("sse4.1")))
+        static inline __m128i mix32Sse41(__m128i value)
+        {
+            value = _mm_xor_si128(value, _mm_srli_epi32(value, 16));
+            value = _mm_mullo_epi32(value, _mm_set1_epi32(static_cast<int>(0x85EBCA6Bu)));
+            value = _mm_xor_si128(value, _mm_srli_epi32(value, 13));
+            value = _mm_mullo_epi32(value, _mm_set1_epi32(static_cast<int>(0xC2B2AE35u)));
+            return _mm_xor_si128(value, _mm_srli_epi32(value, 16));
+        }
+
+        /**
+         * Lookup of a 32 bits entry per lane from four 16 bytes planes, index in 0..15.
+         */
+        __attribute__((target("sse4.1")))
+        static inline __m128i lookupSse41(const uint8_t (*planes)[16], __m128i index)
+        {
+            // Only the low byte of each lane selects, the other ones have the high bit set and read as zero.
+            __m128i selector = _mm_or_si128(index, _mm_set1_epi32(static_cast<int>(0x80808000u)));
+            __m128i value = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(planes[0])), selector);
+            for (int b = 1; b < 4; ++b) {
+                __m128i plane = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(planes[b])), selector);
+                value = _mm_or_si128(value, _mm_slli_epi32(plane, 8 * b));
+            }
+            return value;
+        }
+
+        /**
+         * Four individuals, one per 32 bits lane.
+         */
+        template <const TransitionTable* StaticTable>
+        __attribute__((target("sse4.1")))
+        static inline __m128i transitionGroupSse41(const TransitionTable& table, const uint8_t* states, const uint8_t* neighbourCounts,
+                                                   __m128i columns, __m128i keyLow, __m128i lineKey)
+        {
+            const __m128i signBit = _mm_set1_epi32(static_cast<int>(0x80000000u));
+            int32_t stateBytes;
+            int32_t countBytes;
+            memcpy(&stateBytes, states, sizeof(stateBytes));
+            memcpy(&countBytes, neighbourCounts, sizeof(countBytes));
+            __m128i state = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(stateBytes));
+            __m128i counts = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(countBytes));
+
+            __m128i bits = mix32Sse41(_mm_xor_si128(mix32Sse41(_mm_xor_si128(keyLow, columns)), lineKey));
+            __m128i biasedBits = _mm_xor_si128(bits, signBit);
+
+            __m128i target = _mm_setzero_si128();
+            for (int i = 0; i < TransitionTable::STATE_COUNT; ++i) {
+                __m128i threshold = _mm_xor_si128(lookupSse41(thresholdTable<StaticTable>(table).thresholdPlanes[i], state), signBit);
+                target = _mm_sub_epi32(target, _mm_cmpgt_epi32(biasedBits, threshold));
+            }
+            target = _mm_blendv_epi8(target, state, _mm_cmpeq_epi32(target, _mm_set1_epi32(TransitionTable::STATE_COUNT)));
+
+            __m128i infection = lookupSse41(table.infectionPlanes, _mm_and_si128(counts, _mm_set1_epi32(0x0F)));
+            __m128i infected = _mm_cmpgt_epi32(_mm_xor_si128(infection, signBit), biasedBits);
+            __m128i healthyTarget = _mm_and_si128(infected, _mm_set1_epi32(static_cast<int>(State::sick)));
+
+            __m128i dead = _mm_set1_epi32(static_cast<int>(State::dead));
+            target = _mm_blendv_epi8(target, healthyTarget, _mm_cmpeq_epi32(state, _mm_setzero_si128()));
+            return _mm_blendv_epi8(target, dead, _mm_cmpeq_epi32(state, dead));
+        }
+
+        template <const TransitionTable* StaticTable = nullptr>
+        __attribute__((target("sse4.1")))
+        static void transitionRowSse41(const TransitionTable& table, const uint8_t* states, const uint8_t* neighbourCounts,
+                                       uint8_t* nextStates, int count, uint64_t generationKey, uint32_t line, uint32_t firstColumn)
+        {
+            __m128i keyLow = _mm_set1_epi32(static_cast<int>(static_cast<uint32_t>(generationKey)));
+            __m128i lineKey = _mm_set1_epi32(static_cast<int>(static_cast<uint32_t>(generationKey >> 32) ^ (line * 0x9E3779B9u)));
+            __m128i laneOffsets = _mm_setr_epi32(0, 1, 2, 3);
+
+            int j = 0;
+            for (; j + 16 <= count; j += 16) {
+                __m128i groups[4];
+                for (int g = 0; g < 4; ++g) {
+                    __m128i columns = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(firstColumn + j + 4 * g)), laneOffsets);
+                    groups[g] = transitionGroupSse41<StaticTable>(table, states + j + 4 * g, neighbourCounts + j + 4 * g, columns, keyLow, lineKey);
+                }
+                __m128i packed = _mm_packus_epi16(_mm_packus_epi32(groups[0], groups[1]), _mm_packus_epi32(groups[2], groups[3]));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(nextStates + j), packed);
+            }
+            transitionRowScalar<StaticTable>(table, states + j, neighbourCounts + j, nextStates + j, count - j, generationKey, line, firstColumn + j);
+        }
+
+#endif
+
+        /**
+         * Widest kernel supported by the current processor.
+         */
+        template <const TransitionTable* StaticTable = nullptr>
+        static RowKernel selectRowKernel()
+        {
+#ifdef PANDEMIC_SIM_X86_KERNELS
+            if (__builtin_cpu_supports("avx2")) {
+                return transitionRowAvx2<StaticTable>;
+            }
+            if (__builtin_cpu_supports("sse4.1")) {
+                return transitionRowSse41<StaticTable>;
+            }
+#endif
+            return transitionRowScalar<StaticTable>;
+        }
+
+        /**
+         * Next states of the individuals [firstColumn, firstColumn + count) of a line.
+         */
+        template <const TransitionTable* StaticTable = nullptr>
+        static void transitionRow(const TransitionTable& table, const uint8_t* states, const uint8_t* neighbourCounts,
+                                  uint8_t* nextStates, int count, uint64_t generationKey, uint32_t line, uint32_t firstColumn)
+        {
+            static const RowKernel kernel = selectRowKernel<StaticTable>();
+            kernel(table, states, neighbourCounts, nextStates, count, generationKey, line, firstColumn);
+        }
+
+};
+
+#endif
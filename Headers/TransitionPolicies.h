@@ -0,0 +1,91 @@
+#ifndef TRANSITION_POLICIES_H
+#define TRANSITION_POLICIES_H
+
+#include <cstdint>
+#include <stdexcept>
+#include "State.h"
+#include "TransitionKernel.h"
+#include "TransitionTable.h"
+
+using namespace std;
+
+/**
+ * A states transition probabilities matrix usable as a template argument.
+ */
+template <int NumStates>
+struct TransitionMatrix {
+
+    double probabilities[NumStates][NumStates];
+
+};
+
+/**
+ * Transitions read from a table filled at run time by setTransitionProbabilities.
+ */
+struct DynamicTransitions {
+
+    static const bool IS_DYNAMIC = true;
+
+    static void initialize(TransitionTable&) {}
+
+    static uint8_t transitionCell(const TransitionTable& table, uint8_t state, uint8_t neighbourCounts, uint32_t bits)
+    {
+        return TransitionKernel::transitionCell(table, state, neighbourCounts, bits);
+    }
+
+    static void transitionRow(const TransitionTable& table, const uint8_t* states, const uint8_t* neighbourCounts,
+                              uint8_t* nextStates, int count, uint64_t generationKey, uint32_t line, uint32_t firstColumn)
+    {
+        TransitionKernel::transitionRow(table, states, neighbourCounts, nextStates, count, generationKey, line, firstColumn);
+    }
+
+};
+
+/**
+ * Transitions of a matrix fixed at compile time. The matrix is validated and its cumulative
+ * thresholds are built by the compiler, and every kernel path, scalar or SIMD, is instantiated
+ * for that constant table: the thresholds become immediates instead of loads from the model
+ * table. Every path gives the same results as DynamicTransitions with the same matrix.
+ */
+template <int NumStates, const TransitionMatrix<NumStates>& Matrix>
+struct StaticTransitions {
+
+    static_assert(NumStates == TransitionTable::STATE_COUNT, "The matrix must have one row and column per State value.");
+
+    static constexpr bool hasNonNegativeProbabilities()
+    {
+        for (int state = 0; state < NumStates; ++state) {
+            for (int target = 0; target < NumStates; ++target) {
+                if (Matrix.probabilities[state][target] < 0.0) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    static_assert(hasNonNegativeProbabilities(), "The transition probabilities must not be negative.");
+
+    static const bool IS_DYNAMIC = false;
+
+    static constexpr TransitionTable TABLE = TransitionTable::fromMatrix(Matrix.probabilities);
+
+    static void initialize(TransitionTable& table)
+    {
+        table = TABLE;
+    }
+
+    static uint8_t transitionCell(const TransitionTable& table, uint8_t state, uint8_t neighbourCounts, uint32_t bits)
+    {
+        return TransitionKernel::transitionCell<&TABLE>(table, state, neighbourCounts, bits);
+    }
+
+    static void transitionRow(const TransitionTable& table, const uint8_t* states, const uint8_t* neighbourCounts,
+                              uint8_t* nextStates, int count, uint64_t generationKey, uint32_t line, uint32_t firstColumn)
+    {
+        TransitionKernel::transitionRow<&TABLE>(table, states, neighbourCounts, nextStates, count, generationKey, line, firstColumn);
+    }
+
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef TRANSITION_PROBABILITIES_H
+#define TRANSITION_PROBABILITIES_H
+
+#include "TransitionPolicies.h"
+#include "TransitionTable.h"
+
+//Switch the probabilities as you need.
+
+/**
+ * --------------------------------------------------------------
+ *           |  Healthy |  Isolated |   Sick  |  Dead |  Immune
+ *-----------|----------|-----------|---------|-------|----------
+ * Healthy   |   0.62   |    0.3    |   0.05  |  0.0  |  0.03
+ *-----------|----------|-----------|---------|-------|----------
+ * Isolated  |   0.05   |   0.64    |    0.1  | 0.01  |   0.2
+ *-----------|----------|-----------|---------|-------|----------
+ * Sick      |    0.0   |    0.1    |   0.65  |  0.1  |  0.15
+ *-----------|----------|-----------|---------|-------|----------
+ * Dead      |    0.0   |    0.0    |    0.0  |  1.0  |   0.0
+ *-----------|----------|-----------|---------|-------|----------
+ * Immune    |    0.0   |   0.05    |   0.02  |  0.0  |  0.93
+ *-----------|----------|-----------|---------|-------|----------
+ *
+ * The matrix is a compile time constant, so the simulator models are specialised for it.
+ * To give the probabilities at run time, use RandomWalkModel and RandomWalkModelParallel
+ * with setTransitionProbabilities instead.
+ */
+constexpr TransitionMatrix<TransitionTable::STATE_COUNT> TRANSITION_PROBABILITIES = {{
+    {0.62, 0.3, 0.05, 0.0, 0.03}, // healthy
+    {0.05, 0.64, 0.1, 0.01, 0.2}, // isolated
+    {0.0,  0.1,  0.65, 0.1,  0.15}, // sick
+    {0.0,  0.0,  0.0,  1.0,  0.0},  // dead
+    {0.0,  0.05, 0.02, 0.0,  0.93}  // immune
+}};
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef TRANSITION_TABLE_H
+#define TRANSITION_TABLE_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "State.h"
+
+using namespace std;
+
+/**
+ * The transition table holds the model probabilities as 32 bits thresholds, compared
+ * directly against the random bits of each individual:
+ * - a non healthy individual moves to the first state whose cumulative threshold is
+ *   greater than or equal to its bits, or keeps its state when there is none;
+ * - a healthy individual turns sick when its bits are below the infection threshold
+ *   of its number of sick neighbours.
+ * Byte planes of both tables are kept for the SIMD kernels lookups.
+ */
+class TransitionTable {
+
+    public:
+
+        static const int STATE_COUNT = 5;
+
+        static const int MAX_NEIGHBOURS = 16;
+
+        /**
+         * Cumulative thresholds, indexed by [current state][target state].
+         */
+        uint32_t thresholds[STATE_COUNT][STATE_COUNT] = {};
+
+        /**
+         * Infection thresholds, indexed by the number of sick neighbours.
+         */
+        uint32_t infectionThresholds[MAX_NEIGHBOURS] = {};
+
+        /**
+         * Byte b of thresholds[state][target], indexed by [target][b][state].
+         */
+        alignas(16) uint8_t thresholdPlanes[STATE_COUNT][4][16] = {};
+
+        /**
+         * Byte b of infectionThresholds[sickCount], indexed by [b][sickCount].
+         */
+        alignas(16) uint8_t infectionPlanes[4][16] = {};
+
+        /**
+         * Threshold t such that a uniform number u = bits / 2^32 satisfies u <= probability when bits <= t.
+         * Written without floor() so it can be evaluated at compile time.
+         */
+        static constexpr uint32_t toInclusiveThreshold(double probability)
+        {
+            double scaled = probability * 4294967296.0;
+            if (!(scaled > 0.0)) {
+                return 0;
+            }
+            return scaled >= 4294967295.0 ? 0xFFFFFFFFu : static_cast<uint32_t>(scaled);
+        }
+
+        /**
+         * Threshold t such that a uniform number u = bits / 2^32 satisfies u < probability when bits < t.
+         * Written without ceil() so it can be evaluated at compile time.
+         */
+        static constexpr uint32_t toExclusiveThreshold(double probability)
+        {
+            double scaled = probability * 4294967296.0;
+            if (!(scaled > 0.0)) {
+                return 0;
+            }
+            if (scaled > 4294967294.0) {
+                return 0xFFFFFFFFu;
+            }
+            uint32_t truncated = static_cast<uint32_t>(scaled);
+            return static_cast<double>(truncated) < scaled ? truncated + 1 : truncated;
+        }
+
+        /**
+         * Table of a probabilities matrix known at compile time.
+         */
+        template <typename Matrix>
+        static constexpr TransitionTable fromMatrix(const Matrix& probabilities)
+        {
+            TransitionTable table;
+            table.setCumulativeThresholds(probabilities);
+            return table;
+        }
+
+        /**
+         * Build the cumulative thresholds, each row is summed in order as the states are enumerated.
+         */
+        template <typename Matrix>
+        constexpr void setCumulativeThresholds(const Matrix& probabilities)
+        {
+            for (int state = 0; state < STATE_COUNT; ++state) {
+                double cumulativeProbability = 0.0;
+                for (int target = 0; target < STATE_COUNT; ++target) {
+                    cumulativeProbability += probabilities[state][target];
+                    this->thresholds[state][target] = toInclusiveThreshold(cumulativeProbability);
+                }
+            }
+            this->buildThresholdPlanes();
+        }
+
+        /**
+         * Validate and build the cumulative thresholds of a matrix given at run time.
+         */
+        void setTransitionProbabilities(const vector<vector<double>>& transitionProbabilities)
+        {
+            if (transitionProbabilities.size() != STATE_COUNT) {
+                throw invalid_argument("ERROR: The transition probabilities must have " + to_string(STATE_COUNT) + " rows.");
+            }
+            for (int state = 0; state < STATE_COUNT; ++state) {
+                const vector<double>& probabilities = transitionProbabilities[state];
+                if (probabilities.size() != STATE_COUNT) {
+                    throw invalid_argument("ERROR: The transition probabilities must have " + to_string(STATE_COUNT) + " columns.");
+                }
+                for (double probability : probabilities) {
+                    if (probability < 0.0) {
+                        throw invalid_argument("ERROR: The transition probabilities must not be negative.");
+                    }
+                }
+            }
+            this->setCumulativeThresholds(transitionProbabilities);
+        }
+
+        /**
+         * Build the infection thresholds, 1 - (1 - contagionFactor)^k for k sick neighbours.
+         */
+        void setContagionFactor(double contagionFactor)
+        {
+            double escapeProbability = 1.0;
+            for (int sickCount = 0; sickCount < MAX_NEIGHBOURS; ++sickCount) {
+                this->infectionThresholds[sickCount] = toExclusiveThreshold(1.0 - escapeProbability);
+                escapeProbability *= 1.0 - contagionFactor;
+            }
+            for (int b = 0; b < 4; ++b) {
+                for (int sickCount = 0; sickCount < MAX_NEIGHBOURS; ++sickCount) {
+                    this->infectionPlanes[b][sickCount] = static_cast<uint8_t>(this->infectionThresholds[sickCount] >> (8 * b));
+                }
+            }
+        }
+
+    private:
+
+        constexpr void buildThresholdPlanes()
+        {
+            for (int target = 0; target < STATE_COUNT; ++target) {
+                for (int b = 0; b < 4; ++b) {
+                    for (int state = 0; state < STATE_COUNT; ++state) {
+                        this->thresholdPlanes[target][b][state] = static_cast<uint8_t>(this->thresholds[state][target] >> (8 * b));
+                    }
+                }
+            }
+        }
+
+};
+
+#endif
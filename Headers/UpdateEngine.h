@@ -0,0 +1,21 @@
+#ifndef UPDATE_ENGINE_H
+#define UPDATE_ENGINE_H
+
+/**
+ * Strategy used to visit the individuals of a generation.
+ */
+enum class UpdateEngine {
+
+    /**
+     * Every individual of the grid, every generation.
+     */
+    dense = 0,
+
+    /**
+     * Only the active frontier: non healthy individuals and their healthy neighbours.
+     */
+    sparse = 1
+
+};
+
+#endif
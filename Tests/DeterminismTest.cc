@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../Headers/RandomWalkModel.h"
+#include "../Headers/RandomWalkModelParallel.h"
+#include "../Headers/TransitionProbabilities.h"
+#include "../Headers/TransitionKernel.h"
+#include "../Headers/RandomNumberGenerator.h"
+#include "../Headers/Checkpoint.h"
+#include "../Headers/ThreadPool.h"
+
+using namespace std;
+
+/**
+ * Checks that a fixed seed gives the same results whatever the execution mode: the final
+ * population and the state counts of every generation (the -T time series) must match the
+ * serial byte storage dense run with -t N, -R, -E sparse, packed storage and a checkpoint
+ * resume. The transition kernels, SIMD or instantiated for the compile time matrix, are also
+ * compared with the scalar one.
+ *
+ * Build: g++ -std=c++17 -O2 -pthread Tests/DeterminismTest.cc -o DeterminismTest
+ * Usage: DeterminismTest, exits with a failure status when a mode differs.
+ */
+
+using Model = StaticRandomWalkModel<TransitionTable::STATE_COUNT, TRANSITION_PROBABILITIES>;
+
+using ParallelModel = StaticRandomWalkModelParallel<TransitionTable::STATE_COUNT, TRANSITION_PROBABILITIES>;
+
+/**
+ * Thresholds of the kernels instantiated for the compile time matrix.
+ */
+constexpr const TransitionTable* STATIC_TABLE = &StaticTransitions<TransitionTable::STATE_COUNT, TRANSITION_PROBABILITIES>::TABLE;
+
+/**
+ * Gives the test access to the population of a serial or parallel model.
+ */
+template <typename BaseModel>
+class TestModelOf : public BaseModel {
+
+    public:
+
+        using BaseModel::BaseModel;
+
+        /**
+         * The individuals states, one byte each whatever the storage.
+         */
+        vector<uint8_t> getStates() const
+        {
+            const int size = this->population.getSize();
+            vector<uint8_t> states(static_cast<size_t>(size) * size);
+            for (int i = 0; i < size; ++i) {
+                this->population.unpackRow(i, 0, size, states.data() + static_cast<size_t>(i) * size);
+            }
+            return states;
+        }
+
+};
+
+using TestModel = TestModelOf<Model>;
+
+using TestParallelModel = TestModelOf<ParallelModel>;
+
+/**
+ * Final states and state counts of every generation of one run.
+ */
+struct RunResult {
+    vector<uint8_t> states;
+    vector<uint32_t> stateHistory;
+
+    bool operator==(const RunResult& other) const
+    {
+        return this->states == other.states && this->stateHistory == other.stateHistory;
+    }
+};
+
+const int POPULATION_SIZE = 150;
+const int GENERATIONS = 30;
+const int RUNS = 4;
+const uint64_t SEED = 7;
+const double CONTAGION_FACTOR = 0.5;
+
+/**
+ * Workers of the parallel modes, more than one whatever the processor, so the tiles are stolen
+ * and the per worker counts merged.
+ */
+const int THREAD_COUNT = 4;
+
+int failures = 0;
+
+void check(bool condition, const string& name)
+{
+    cout << (condition ? "PASSED " : "FAILED ") << name << endl;
+    failures += condition ? 0 : 1;
+}
+
+template <typename TestedModel>
+RunResult getRunResult(const TestedModel& model)
+{
+    return {model.getStates(), model.getStateHistory()};
+}
+
+/**
+ * Every run on a single serial model, reset between runs.
+ */
+vector<RunResult> simulateSerial(GridStorage storage, UpdateEngine engine)
+{
+    vector<RunResult> results;
+    TestModel model(POPULATION_SIZE, CONTAGION_FACTOR, true, storage);
+    for (int i = 0; i < RUNS; ++i) {
+        if (i > 0) {
+            model.reset();
+        }
+        model.setRandomStream(SEED, i);
+        model.setUpdateEngine(engine);
+        model.setStateHistory(true);
+        model.simulation(GENERATIONS);
+        results.push_back(getRunResult(model));
+    }
+    return results;
+}
+
+/**
+ * Every run on a model splitting each generation between the threads, as -t does.
+ */
+vector<RunResult> simulateParallel(GridStorage storage, UpdateEngine engine)
+{
+    vector<RunResult> results;
+    ThreadPool threadPool(THREAD_COUNT);
+    TestParallelModel model(POPULATION_SIZE, CONTAGION_FACTOR, true, threadPool, storage);
+    for (int i = 0; i < RUNS; ++i) {
+        if (i > 0) {
+            model.reset();
+        }
+        model.setRandomStream(SEED, i);
+        model.setUpdateEngine(engine);
+        model.setStateHistory(true);
+        model.parallelSimulation(GENERATIONS);
+        results.push_back(getRunResult(model));
+    }
+    return results;
+}
+
+/**
+ * Whole runs dealt to the threads, each one reusing its own model, as -R does.
+ */
+vector<RunResult> simulateRuns(GridStorage storage)
+{
+    vector<RunResult> results(RUNS);
+    ThreadPool threadPool(THREAD_COUNT);
+    vector<unique_ptr<TestModel>> models(threadPool.getThreadCount());
+    atomic<int> nextRun(0);
+    threadPool.execute([&](int worker) {
+        unique_ptr<TestModel>& model = models[worker];
+        int i;
+        while ((i = nextRun.fetch_add(1)) < RUNS) {
+            if (model) {
+                model->reset();
+            } else {
+                model = make_unique<TestModel>(POPULATION_SIZE, CONTAGION_FACTOR, true, storage);
+            }
+            model->setRandomStream(SEED, i);
+            model->setStateHistory(true);
+            model->simulation(GENERATIONS);
+            results[i] = getRunResult(*model);
+        }
+    });
+    return results;
+}
+
+/**
+ * Every run checkpointed, then finished by a new model from its last checkpoint, as -k and -u do.
+ * The time series only covers the generations after the checkpoint, it is compared with the
+ * end of the reference one.
+ */
+bool resumeMatches(GridStorage storage, int checkpointInterval, const vector<RunResult>& reference)
+{
+    const string filename = "DeterminismTest.checkpoint";
+    bool matches = true;
+    for (int i = 0; i < RUNS; ++i) {
+        TestModel model(POPULATION_SIZE, CONTAGION_FACTOR, true, storage);
+        model.setRandomStream(SEED, i);
+        model.setCheckpoint(filename, checkpointInterval, RUNS);
+        model.simulation(GENERATIONS);
+
+        TestModel resumedModel(POPULATION_SIZE, CONTAGION_FACTOR, true, storage);
+        int generation = static_cast<int>(resumedModel.loadCheckpoint(filename).generation);
+        resumedModel.setStateHistory(true);
+        resumedModel.simulation(GENERATIONS - generation);
+
+        vector<uint32_t> expectedHistory;
+        const vector<uint32_t>& history = reference[i].stateHistory;
+        const size_t length = GENERATIONS + 1;
+        for (int state = 0; state < TransitionTable::STATE_COUNT; ++state) {
+            expectedHistory.insert(expectedHistory.end(), history.begin() + state * length + generation,
+                                   history.begin() + (state + 1) * length);
+        }
+        matches = matches && resumedModel.getStates() == reference[i].states
+                          && resumedModel.getStateHistory() == expectedHistory;
+    }
+    Checkpoint::remove(filename);
+    return matches;
+}
+
+/**
+ * Compare a row kernel with the scalar one on random rows of every length up to a few vectors,
+ * starting on odd and even columns.
+ */
+bool kernelMatchesScalar(TransitionKernel::RowKernel kernel)
+{
+    TransitionTable table = TransitionTable::fromMatrix(TRANSITION_PROBABILITIES.probabilities);
+    table.setContagionFactor(CONTAGION_FACTOR);
+    const int maximumCount = 100;
+    vector<uint8_t> states(maximumCount);
+    vector<uint8_t> neighbourCounts(maximumCount);
+    vector<uint8_t> expected(maximumCount);
+    vector<uint8_t> actual(maximumCount);
+    uint64_t key = RandomNumberGenerator(SEED).getGenerationKey(0, 0);
+    for (int count = 0; count <= maximumCount; ++count) {
+        for (uint32_t line = 0; line < 4; ++line) {
+            uint32_t firstColumn = line * 33;
+            for (int j = 0; j < count; ++j) {
+                uint32_t bits = RandomNumberGenerator::getRandomBits(key, line + count * 4, j);
+                uint32_t sickCount = (bits >> 8) % 9;
+                uint32_t isolatedCount = (bits >> 16) % (9 - sickCount);
+                states[j] = static_cast<uint8_t>(bits % TransitionTable::STATE_COUNT);
+                neighbourCounts[j] = static_cast<uint8_t>(sickCount | isolatedCount << 4);
+            }
+            uint64_t generationKey = RandomNumberGenerator(SEED).getGenerationKey(count, line);
+            TransitionKernel::transitionRowScalar<>(table, states.data(), neighbourCounts.data(), expected.data(), count, generationKey, line, firstColumn);
+            kernel(table, states.data(), neighbourCounts.data(), actual.data(), count, generationKey, line, firstColumn);
+            if (!equal(expected.begin(), expected.begin() + count, actual.begin())) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    try {
+        const vector<RunResult> reference = simulateSerial(GridStorage::bytes, UpdateEngine::dense);
+        // A grid where nothing happened would make every comparison pass.
+        check(reference[0].stateHistory.size() == static_cast<size_t>(TransitionTable::STATE_COUNT) * (GENERATIONS + 1)
+              && reference[0].states != vector<uint8_t>(reference[0].states.size(), 0), "reference run");
+
+        check(simulateSerial(GridStorage::packed, UpdateEngine::dense) == reference, "packed storage");
+        check(simulateSerial(GridStorage::bytes, UpdateEngine::sparse) == reference, "sparse engine");
+        check(simulateSerial(GridStorage::packed, UpdateEngine::sparse) == reference, "sparse engine, packed storage");
+
+        check(simulateParallel(GridStorage::bytes, UpdateEngine::dense) == reference, "parallel generations");
+        check(simulateParallel(GridStorage::packed, UpdateEngine::dense) == reference, "parallel generations, packed storage");
+        check(simulateParallel(GridStorage::bytes, UpdateEngine::sparse) == reference, "parallel sparse engine");
+        check(simulateParallel(GridStorage::packed, UpdateEngine::sparse) == reference, "parallel sparse engine, packed storage");
+
+        check(simulateRuns(GridStorage::bytes) == reference, "parallel runs");
+        check(simulateRuns(GridStorage::packed) == reference, "parallel runs, packed storage");
+
+        check(resumeMatches(GridStorage::bytes, 13, reference), "checkpoint resume");
+        check(resumeMatches(GridStorage::packed, 13, reference), "checkpoint resume, packed storage");
+        check(resumeMatches(GridStorage::bytes, GENERATIONS + 10, reference), "checkpoint resume from the first generation");
+
+        check(kernelMatchesScalar(TransitionKernel::transitionRowScalar<STATIC_TABLE>), "static scalar transition kernel");
+#ifdef PANDEMIC_SIM_X86_KERNELS
+        if (__builtin_cpu_supports("sse4.1")) {
+            check(kernelMatchesScalar(TransitionKernel::transitionRowSse41<>), "SSE4.1 transition kernel");
+            check(kernelMatchesScalar(TransitionKernel::transitionRowSse41<STATIC_TABLE>), "static SSE4.1 transition kernel");
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            check(kernelMatchesScalar(TransitionKernel::transitionRowAvx2<>), "AVX2 transition kernel");
+            check(kernelMatchesScalar(TransitionKernel::transitionRowAvx2<STATIC_TABLE>), "static AVX2 transition kernel");
+        }
+#endif
+    } catch (const exception& exception) {
+        cerr << exception.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (failures > 0) {
+        cerr << failures << " check(s) failed." << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
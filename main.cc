@@ -1,13 +1,31 @@
 #include <getopt.h>
+#include <cctype>
+#include <atomic>
 #include <memory>
 #include <string>
 #include "Headers/RandomWalkModel.h"
 #include "Headers/RandomWalkModelParallel.h"
+#include "Headers/TransitionProbabilities.h"
+#include "Headers/ThreadPool.h"
 #include "Headers/State.h"
+#include "Headers/UpdateEngine.h"
+#include "Headers/GridStorage.h"
+#include "Headers/TimeSeriesWriter.h"
+#include "Headers/ResultFormat.h"
+#include "Headers/ResultSink.h"
+#include "Headers/FrameFormat.h"
+#include "Headers/FrameExporter.h"
+#include "Headers/Checkpoint.h"
+#include "Headers/Profiler.h"
+#include "Headers/Timestamp.h"
 #include "Headers/ProgramInfoViewer.h"
 
 using namespace std;
 
+using Model = StaticRandomWalkModel<TransitionTable::STATE_COUNT, TRANSITION_PROBABILITIES>;
+
+using ParallelModel = StaticRandomWalkModelParallel<TransitionTable::STATE_COUNT, TRANSITION_PROBABILITIES>;
+
 int main(int argc, char* argv[])
 {
     //Default params.
@@ -19,10 +37,24 @@ int main(int argc, char* argv[])
     bool applySocialDistanceEffect = false;
     int threadCount = 1;
     bool generateImage = false;
+    int imageScale = 1;
+    bool generateImageTiles = false;
+    string checkpointFilename;
+    int checkpointInterval = 10;
+    string resumeFilename;
+    string profileFilename;
+    bool runParallel = false;
+    UpdateEngine engine = UpdateEngine::dense;
+    GridStorage storage = GridStorage::bytes;
+    string timeSeriesFilename;
+    ResultFormat resultFormat = ResultFormat::plain;
+    int framesInterval = 0;
+    FrameFormat frameFormat = FrameFormat::png;
+    uint64_t seed = RandomNumberGenerator::getEntropySeed();
     
     //Parse CLI options.
     //Don't move.
-    const char* shortOptions = "r:p:g:st:c:o:ihv";
+    const char* shortOptions = "r:p:g:st:c:o:S:RE:PT:F:f:m:iz:Zk:K:u:x:hv";
     const option longOptions[] = {
         {"runs", optional_argument, nullptr, 'r'},
         {"population", optional_argument, nullptr, 'p'},
@@ -31,7 +63,21 @@ int main(int argc, char* argv[])
         {"threads", optional_argument, nullptr, 't'},
         {"contagion-factor", optional_argument, nullptr, 'c'},
         {"output-state", optional_argument, nullptr, 'o'},
+        {"seed", optional_argument, nullptr, 'S'},
+        {"run-parallel", no_argument, nullptr, 'R'},
+        {"engine", optional_argument, nullptr, 'E'},
+        {"packed", no_argument, nullptr, 'P'},
+        {"timeseries", required_argument, nullptr, 'T'},
+        {"format", required_argument, nullptr, 'F'},
+        {"frames", required_argument, nullptr, 'f'},
+        {"frames-format", required_argument, nullptr, 'm'},
         {"image", no_argument, nullptr, 'i'},
+        {"image-scale", required_argument, nullptr, 'z'},
+        {"image-tiles", no_argument, nullptr, 'Z'},
+        {"checkpoint", required_argument, nullptr, 'k'},
+        {"checkpoint-interval", required_argument, nullptr, 'K'},
+        {"resume", required_argument, nullptr, 'u'},
+        {"profile", required_argument, nullptr, 'x'},
         {"version", no_argument, nullptr, 'v'},
         {"help", no_argument, nullptr, 'h'},
         {nullptr, no_argument, nullptr, 0}
@@ -102,8 +148,7 @@ int main(int argc, char* argv[])
             }
             try {
                 int requestedStateValue = stoi(optarg);
-                int stateEnumValuesCount = 5;
-                if (requestedStateValue < 0 || requestedStateValue > stateEnumValuesCount) {
+                if (requestedStateValue < 0 || requestedStateValue >= TransitionTable::STATE_COUNT) {
                     throw out_of_range("ERROR: Invalid state: " + to_string(requestedStateValue) + ".");
                 }
                 requestedStateCount = requestedStateValue;
@@ -112,9 +157,120 @@ int main(int argc, char* argv[])
                 exit(EXIT_FAILURE);
             }
         } break;
+        case 'S': {
+            if (optarg == nullptr && optind < argc && argv[optind][0] != '-') {
+                optarg = argv[optind++];
+            }
+            try {
+                //stoull would wrap a negative value and ignore trailing characters.
+                size_t parsedLength = 0;
+                if (optarg == nullptr || !isdigit(static_cast<unsigned char>(optarg[0]))) {
+                    throw invalid_argument("-S");
+                }
+                seed = stoull(optarg, &parsedLength);
+                if (optarg[parsedLength] != '\0') {
+                    throw invalid_argument("-S");
+                }
+            } catch (const exception&) {
+                cerr << "ERROR: Invalid argument for -S. Expected an unsigned integer." << endl;
+                exit(EXIT_FAILURE);
+            }
+        } break;
+        case 'R': {
+            runParallel = true;
+        } break;
+        case 'E': {
+            if (optarg == nullptr && optind < argc && argv[optind][0] != '-') {
+                optarg = argv[optind++];
+            }
+            string requestedEngine = optarg == nullptr ? "" : optarg;
+            if (requestedEngine == "dense") {
+                engine = UpdateEngine::dense;
+            } else if (requestedEngine == "sparse") {
+                engine = UpdateEngine::sparse;
+            } else {
+                cerr << "ERROR: Invalid engine: " << requestedEngine << ". Expected dense or sparse." << endl;
+                exit(EXIT_FAILURE);
+            }
+        } break;
+        case 'P': {
+            storage = GridStorage::packed;
+        } break;
+        case 'T': {
+            timeSeriesFilename = optarg;
+        } break;
+        case 'F': {
+            string requestedFormat = optarg;
+            if (requestedFormat == "plain") {
+                resultFormat = ResultFormat::plain;
+            } else if (requestedFormat == "csv") {
+                resultFormat = ResultFormat::csv;
+            } else if (requestedFormat == "jsonl") {
+                resultFormat = ResultFormat::jsonLines;
+            } else {
+                cerr << "ERROR: Invalid format: " << requestedFormat << ". Expected plain, csv or jsonl." << endl;
+                exit(EXIT_FAILURE);
+            }
+        } break;
+        case 'f': {
+            try {
+                framesInterval = stoi(optarg);
+                if (framesInterval < 1) {
+                    throw out_of_range("ERROR: The frames interval must be at least 1.");
+                }
+            } catch (const exception&) {
+                cerr << "ERROR: Invalid argument for -f. Expected a positive integer." << endl;
+                exit(EXIT_FAILURE);
+            }
+        } break;
+        case 'm': {
+            string requestedFrameFormat = optarg;
+            if (requestedFrameFormat == "png") {
+                frameFormat = FrameFormat::png;
+            } else if (requestedFrameFormat == "rgb") {
+                frameFormat = FrameFormat::rgb;
+            } else {
+                cerr << "ERROR: Invalid frames format: " << requestedFrameFormat << ". Expected png or rgb." << endl;
+                exit(EXIT_FAILURE);
+            }
+        } break;
         case 'i': {
             generateImage = true;
         } break;
+        case 'z': {
+            try {
+                imageScale = stoi(optarg);
+                if (imageScale < 1) {
+                    throw out_of_range("ERROR: The image scale must be at least 1.");
+                }
+            } catch (const exception&) {
+                cerr << "ERROR: Invalid argument for -z. Expected a positive integer." << endl;
+                exit(EXIT_FAILURE);
+            }
+        } break;
+        case 'Z': {
+            generateImageTiles = true;
+        } break;
+        case 'k': {
+            checkpointFilename = optarg;
+        } break;
+        case 'K': {
+            try {
+                checkpointInterval = stoi(optarg);
+                if (checkpointInterval < 1) {
+                    throw out_of_range("ERROR: The checkpoint interval must be at least 1.");
+                }
+            } catch (const exception&) {
+                cerr << "ERROR: Invalid argument for -K. Expected a positive integer." << endl;
+                exit(EXIT_FAILURE);
+            }
+        } break;
+        case 'u': {
+            resumeFilename = optarg;
+        } break;
+        case 'x': {
+            profileFilename = optarg;
+        } break;
         case 'h':
             printHelp();
             exit(EXIT_SUCCESS);
@@ -127,70 +283,213 @@ int main(int argc, char* argv[])
     }
 }
 
-    //Switch the probabilities as you need.
+    //A resumed simulation continues with the parameters of its checkpoint.
+    Checkpoint::CheckpointHeader resumedCheckpoint;
+    bool resume = !resumeFilename.empty();
+    if (resume) {
+        try {
+            resumedCheckpoint = Checkpoint::readHeader(resumeFilename);
+        } catch (const exception& exception) {
+            cerr << exception.what() << endl;
+            exit(EXIT_FAILURE);
+        }
+        numberOfRuns = resumedCheckpoint.runCount;
+        populationMatrixSize = resumedCheckpoint.populationMatrixSize;
+        numberOfGenerations = resumedCheckpoint.generationCount;
+        contagionFactor = resumedCheckpoint.initialContagionFactor;
+        applySocialDistanceEffect = resumedCheckpoint.socialDistanceEffect != 0;
+        storage = static_cast<GridStorage>(resumedCheckpoint.storage);
+        seed = resumedCheckpoint.seed;
+    }
+    if (runParallel && (resume || !checkpointFilename.empty())) {
+        cerr << "ERROR: Checkpoints are not supported with -R." << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (resume && !timeSeriesFilename.empty()) {
+        cerr << "ERROR: The time series of a resumed simulation would miss its first runs, -T is not supported with -u." << endl;
+        exit(EXIT_FAILURE);
+    }
+    int firstRun = resume ? static_cast<int>(resumedCheckpoint.run) : 0;
 
-    /**
-     * --------------------------------------------------------------
-     *           |  Healthy |  Isolated |   Sick  |  Dead |  Immune
-     *-----------|----------|-----------|---------|-------|----------
-     * Healthy   |   0.62   |    0.3    |   0.05  |  0.0  |  0.03
-     *-----------|----------|-----------|---------|-------|----------
-     * Isolated  |   0.05   |   0.64    |    0.1  | 0.01  |   0.2
-     *-----------|----------|-----------|---------|-------|----------
-     * Sick      |    0.0   |    0.1    |   0.65  |  0.1  |  0.15
-     *-----------|----------|-----------|---------|-------|----------
-     * Dead      |    0.0   |    0.0    |    0.0  |  1.0  |   0.0
-     *-----------|----------|-----------|---------|-------|----------
-     * Immune    |    0.0   |   0.05    |   0.02  |  0.0  |  0.93
-     *-----------|----------|-----------|---------|-------|----------
-     */
-    vector<vector<double>> transitionProbabilities = {
-        {0.62, 0.3, 0.05, 0.0, 0.03}, // healthy
-        {0.05, 0.64, 0.1, 0.01, 0.2}, // isolated
-        {0.0,  0.1,  0.65, 0.1,  0.15}, // sick
-        {0.0,  0.0,  0.0,  1.0,  0.0},  // dead
-        {0.0,  0.05, 0.02, 0.0,  0.93}  // immune
-    };
     bool isMultiThreading = threadCount > 1;
+    //Both the split generations and the -R runs share the same threads limit.
+    try {
+        MultithreadingController::throwIfThreadCountIsNotSupported(threadCount);
+    } catch (const out_of_range& exception) {
+        cerr << exception.what() << endl;
+        exit(EXIT_FAILURE);
+    }
 
     printHeaders(
         new int[4]{numberOfRuns, populationMatrixSize, numberOfGenerations, threadCount},
-        new bool[2]{applySocialDistanceEffect, generateImage},
-        new double[1]{contagionFactor}
+        new bool[4]{applySocialDistanceEffect, generateImage, runParallel, storage == GridStorage::packed},
+        new double[1]{contagionFactor},
+        seed
     );
 
+    if (!profileFilename.empty()) {
+        Profiler::getInstance().enable();
+    }
+
     /**
      * Executes the model.
      */
     try
     {
-        if(isMultiThreading) {
-            unique_ptr<RandomWalkModelParallel> model;
-            for(int i = 0; i < numberOfRuns; ++i) {
-                model = make_unique<RandomWalkModelParallel>(populationMatrixSize, contagionFactor, applySocialDistanceEffect, threadCount);
-                model->setTransitionProbabilities(transitionProbabilities);
-                model->parallelSimulation(numberOfGenerations);
+        unique_ptr<TimeSeriesWriter> timeSeriesWriter;
+        if(!timeSeriesFilename.empty()) {
+            timeSeriesWriter = make_unique<TimeSeriesWriter>(timeSeriesFilename, numberOfRuns, numberOfGenerations, populationMatrixSize,
+                                                             seed, contagionFactor, applySocialDistanceEffect);
+        }
+        ResultSink resultSink(resultFormat, State(requestedStateCount));
+
+        //The frames of the last run are exported while it is simulated.
+        unique_ptr<FrameExporter> frameExporter;
+        if(framesInterval > 0) {
+            frameExporter = make_unique<FrameExporter>(framesInterval, frameFormat, "Frames_" + getTimestamp(), populationMatrixSize);
+        }
+
+        if(runParallel) {
+            //Each worker simulates whole runs on its own model, reset between runs, the results are printed in run order.
+            ThreadPool threadPool(threadCount);
+            ConcurrentResultSink concurrentResultSink(resultSink);
+            vector<unique_ptr<Model>> models(threadPool.getThreadCount());
+            Model* lastModel = nullptr;
+            atomic<int> nextRun(0);
+            threadPool.execute([&](int worker) {
+                unique_ptr<Model>& model = models[worker];
+                int i;
+                while((i = nextRun.fetch_add(1)) < numberOfRuns) {
+                    if(model) {
+                        model->reset();
+                    }
+                    else {
+                        model = make_unique<Model>(populationMatrixSize, contagionFactor, applySocialDistanceEffect, storage);
+                    }
+                    model->setRandomStream(seed, i);
+                    model->setUpdateEngine(engine);
+                    model->setStateHistory(timeSeriesWriter != nullptr);
+                    model->setFrameExporter(i == numberOfRuns - 1 ? frameExporter.get() : nullptr);
+                    model->simulation(numberOfGenerations);
+                    concurrentResultSink.write(i, model->getStateCount(State(requestedStateCount)));
+                    if(timeSeriesWriter) {
+                        timeSeriesWriter->writeRun(i, model->getStateHistory());
+                    }
+                    //The last run is the last one its worker takes.
+                    if(i == numberOfRuns - 1) {
+                        lastModel = model.get();
+                    }
+                }
+            });
+            concurrentResultSink.close();
+            if(frameExporter) {
+                frameExporter->close();
+            }
+            if(generateImage && lastModel) {
+                lastModel->generateImage(imageScale);
+            }
+            if(generateImageTiles && lastModel) {
+                lastModel->generateImageTiles();
+            }
+        }
+        else if(isMultiThreading) {
+            ThreadPool threadPool(threadCount);
+            auto model = make_unique<ParallelModel>(populationMatrixSize, contagionFactor, applySocialDistanceEffect, threadPool, storage);
+            for(int i = firstRun; i < numberOfRuns; ++i) {
+                if(i > firstRun) {
+                    model->reset();
+                }
+                model->setRandomStream(seed, i);
+                model->setUpdateEngine(engine);
+                model->setStateHistory(timeSeriesWriter != nullptr);
+                model->setFrameExporter(i == numberOfRuns - 1 ? frameExporter.get() : nullptr);
+                int generations = numberOfGenerations;
+                if(!checkpointFilename.empty()) {
+                    model->setCheckpoint(checkpointFilename, checkpointInterval, numberOfRuns);
+                }
+                if(resume && i == firstRun) {
+                    generations -= model->loadCheckpoint(resumeFilename).generation;
+                }
+                model->parallelSimulation(max(generations, 0));
+                if(timeSeriesWriter) {
+                    timeSeriesWriter->writeRun(i, model->getStateHistory());
+                }
                 //Print the individuals count based on current state.
-                cout << model->getStateCount(State(requestedStateCount)) << endl;
+                resultSink.write(i, model->getStateCount(State(requestedStateCount)));
+                //A checkpoint only holds the run in progress, the finished ones must be written before the next one is saved.
+                if(!checkpointFilename.empty()) {
+                    resultSink.flush();
+                    if(timeSeriesWriter) {
+                        timeSeriesWriter->flush();
+                    }
+                }
+            }
+            resultSink.flush();
+            if(!checkpointFilename.empty()) {
+                Checkpoint::remove(checkpointFilename);
+            }
+            if(frameExporter) {
+                frameExporter->close();
             }
             if(generateImage) {
-                model->generateImage();
+                model->generateImage(imageScale);
+            }
+            if(generateImageTiles) {
+                model->generateImageTiles();
             }
         }
         else {
-            unique_ptr<RandomWalkModel> model;
-            for(int i = 0; i < numberOfRuns; ++i) {
-                model = make_unique<RandomWalkModel>(populationMatrixSize, contagionFactor, applySocialDistanceEffect);
-                model->setTransitionProbabilities(transitionProbabilities);
-                model->simulation(numberOfGenerations);
+            auto model = make_unique<Model>(populationMatrixSize, contagionFactor, applySocialDistanceEffect, storage);
+            for(int i = firstRun; i < numberOfRuns; ++i) {
+                if(i > firstRun) {
+                    model->reset();
+                }
+                model->setRandomStream(seed, i);
+                model->setUpdateEngine(engine);
+                model->setStateHistory(timeSeriesWriter != nullptr);
+                model->setFrameExporter(i == numberOfRuns - 1 ? frameExporter.get() : nullptr);
+                int generations = numberOfGenerations;
+                if(!checkpointFilename.empty()) {
+                    model->setCheckpoint(checkpointFilename, checkpointInterval, numberOfRuns);
+                }
+                if(resume && i == firstRun) {
+                    generations -= model->loadCheckpoint(resumeFilename).generation;
+                }
+                model->simulation(max(generations, 0));
+                if(timeSeriesWriter) {
+                    timeSeriesWriter->writeRun(i, model->getStateHistory());
+                }
                 //Print the individuals count based on current state.
-                cout << model->getStateCount(State(requestedStateCount)) << endl;
+                resultSink.write(i, model->getStateCount(State(requestedStateCount)));
+                //A checkpoint only holds the run in progress, the finished ones must be written before the next one is saved.
+                if(!checkpointFilename.empty()) {
+                    resultSink.flush();
+                    if(timeSeriesWriter) {
+                        timeSeriesWriter->flush();
+                    }
+                }
+            }
+            resultSink.flush();
+            if(!checkpointFilename.empty()) {
+                Checkpoint::remove(checkpointFilename);
+            }
+            if(frameExporter) {
+                frameExporter->close();
             }
             if(generateImage) {
-                model->generateImage();
+                model->generateImage(imageScale);
+            }
+            if(generateImageTiles) {
+                model->generateImageTiles();
             }
         }
 
+        if(!profileFilename.empty()) {
+            Profiler::getInstance().printReport(cout);
+            Profiler::getInstance().writeJson(profileFilename);
+            cout << "Profile saved successfully as " << profileFilename << endl;
+        }
+
         return EXIT_SUCCESS;
     }
     catch(invalid_argument& exception)